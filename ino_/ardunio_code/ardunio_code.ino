@@ -2,16 +2,41 @@
 #include <Mouse.h>
 
 // ========== 協議定義 ==========
+// V1: [0xAA][LEN 1~31][DATA][CRC-8]
+// V2: [0xAB][LEN 1~255][DATA][CRC-16 H][CRC-16 L], CRC 涵蓋 LEN + DATA
 #define SYNC_BYTE             0xAA
+#define SYNC_BYTE_V2          0xAB
 #define MAX_PACKET_SIZE       32
+#define MAX_PAYLOAD_V2        255
 #define SERIAL_BUFFER_SIZE    128
 
+// 協議能力 (CMD_GET_CAPS 回應)
+#define PROTOCOL_VERSION      2
+#define FEATURE_FRAME_V2      0x01
+#define FEATURE_LOOPBACK      0x02  // CMD_ECHO / CMD_SINK
+#define FEATURE_MEMINFO       0x04  // CMD_GET_MEMINFO
+#define FEATURE_KB_USAGES     0x08  // CMD_KB_USAGES
+#define FEATURE_KB_PRINT_Z    0x10  // CMD_KB_PRINT_Z
+#define FEATURE_SERIAL1_CMD   0x20  // Serial1 也接受封包指令
+#define FEATURE_ABORT_STATS   0x40  // CMD_GET_ABORT_STATS
+#define FEATURE_MOUSE_DRAG    0x80  // CMD_MOUSE_DRAG
+
 // ACK 代碼
 #define ACK_SUCCESS           0xF0
 #define ACK_CRC_ERROR         0xF1
 #define ACK_INVALID_CMD       0xF2
 #define ACK_PARAM_ERROR       0xF3
 #define ACK_INTERRUPTED       0xF4  // 新增:被中斷
+#define ACK_QUEUE_FULL        0xF7  // 佇列已滿, Host 稍後重送
+
+// 事件封包 (Device → Host, 非請求): [EVT_MARKER][EVT][ARG]
+#define EVT_MARKER            0xF5
+#define EVT_BUTTON            0x01  // ARG = 綁定設定的值
+#define EVT_QUEUE_PAUSED      0x02  // ARG = 1 暫停 / 0 恢復
+
+// 回應封包 (Device → Host, 緊接在查詢指令的 ACK 之後)
+// [RESP_MARKER][LEN][DATA][CRC-16 H][CRC-16 L], CRC 涵蓋 LEN + DATA
+#define RESP_MARKER           0xF6
 
 // 指令定義
 #define CMD_MOUSE_MOVE        0x01
@@ -19,76 +44,228 @@
 #define CMD_MOUSE_RELEASE     0x03
 #define CMD_MOUSE_CLICK       0x04
 #define CMD_MOUSE_PRESS_TIMED 0x05
+#define CMD_MOUSE_DRAG        0x06  // 按下 → 依時間移動 → 放開, 非阻塞
 #define CMD_KB_PRESS          0x10
 #define CMD_KB_RELEASE        0x11
 #define CMD_KB_WRITE          0x12
 #define CMD_KB_RELEASE_ALL    0x13
 #define CMD_KB_PRINT          0x14
 #define CMD_KB_PRESS_TIMED    0x15
+#define CMD_KB_USAGES         0x16  // Host 預先編譯的 [MOD][USAGE] 序列
+#define CMD_KB_PRINT_Z        0x17  // RLE + LZ 壓縮的 KB_PRINT
 #define CMD_PAUSE_LOG         0x20  // 新增:暫停日誌
 #define CMD_RESUME_LOG        0x21  // 新增:恢復日誌
 #define CMD_CLEAR_QUEUE       0x22  // 新增:清空佇列
+#define CMD_GET_CAPS          0x23  // 查詢協議能力 (有回應封包)
+#define CMD_ECHO              0x24  // 原封不動回傳 PARAMS (有回應封包)
+#define CMD_SINK              0x25  // 接著接收 N bytes 原始資料並丟棄, 完成後回報耗時
+#define CMD_GET_MEMINFO       0x26  // 查詢 SRAM 使用量 (有回應封包)
+#define CMD_GET_ABORT_STATS   0x27  // 查詢中斷按鈕到釋放按鍵的延遲 (有回應封包)
+
+// CMD_GET_MEMINFO 回應中的靜態結構編號
+#define MEM_ID_QUEUE          0x01
+#define MEM_ID_RX_CHANNELS    0x02
+#define MEM_ID_LOGGER         0x03
+#define MEM_ID_TIMED_ACTION   0x04
+#define MEM_ID_BUTTONS        0x05
+#define MEM_ID_SINK           0x06
+#define MEM_ID_SERIAL1        0x07
+#define MEM_ID_Z_WINDOW       0x08
+
+// ========== Serial1 設定 ==========
+// LOG: 單向文字日誌
+// COMMAND: 與 USB 相同的封包協議, 讓外部控制器 (MCU / 單板電腦) 不經過 PC 直接下指令,
+//          ACK 與回應封包送回 Serial1, 日誌關閉 (Serial1 TX 用來回覆)
+#define SERIAL1_MODE_LOG      0
+#define SERIAL1_MODE_COMMAND  1
+#define SERIAL1_MODE          SERIAL1_MODE_LOG
+#define SERIAL1_LOG_BAUD      115200
+#define SERIAL1_CMD_BAUD      1000000  // 16 MHz 下 1M / 2M baud 誤差為 0
+#define SERIAL1_RX_TIMEOUT_MS 3        // 最大封包 (258 bytes) 在 1 Mbaud 下約 2.6 ms
+#define LOG_AVAILABLE         (SERIAL1_MODE == SERIAL1_MODE_LOG)
 
 // ========== 硬體按鈕設定 ==========
 #define INTERRUPT_PIN         2     // 使用支援中斷的 PIN (Arduino Micro: 0,1,2,3,7)
 #define BUTTON_DEBOUNCE_MS    50    // 防彈跳時間
 
+// 按鈕動作
+#define BTN_ACTION_ABORT       0    // 中斷全部 (清空佇列 + 釋放按鍵)
+#define BTN_ACTION_PAUSE_QUEUE 1    // 暫停/恢復佇列執行
+#define BTN_ACTION_RUN_MACRO   2    // 立即執行儲存的巨集 (不經過佇列), arg = slot
+#define BTN_ACTION_EMIT_EVENT  3    // 送出 EVT_BUTTON 給 Host, arg = 事件值
+
+struct ButtonBinding {
+    uint8_t pin;
+    uint8_t edge;         // FALLING / RISING / CHANGE
+    uint8_t debounce_ms;
+    uint8_t action;
+    uint8_t arg;
+};
+
+// 按鈕綁定表 (最多 MAX_BUTTON_BINDINGS 組)
+// 注意: PIN 0/1 是 Serial1 的 RX/TX, 日誌開啟時不可使用
+const ButtonBinding BUTTON_BINDINGS[] = {
+    // pin,           edge,    debounce,           action,                 arg
+    { INTERRUPT_PIN,  FALLING, BUTTON_DEBOUNCE_MS, BTN_ACTION_ABORT,       0 },
+    // { 3,           FALLING, 50,                 BTN_ACTION_PAUSE_QUEUE, 0 },
+    // { 7,           FALLING, 50,                 BTN_ACTION_RUN_MACRO,   0 },
+};
+#define BUTTON_COUNT        (sizeof(BUTTON_BINDINGS) / sizeof(BUTTON_BINDINGS[0]))
+#define MAX_BUTTON_BINDINGS 4
+
 // ========== 全域狀態 ==========
 volatile bool g_interrupt_flag = false;  // 中斷旗標
-volatile bool g_log_enabled = true;      // 日誌啟用狀態
-uint32_t last_button_press = 0;          // 防彈跳計時器
+volatile uint32_t g_abort_start_us = 0;  // 中斷按鈕按下的時間 (micros)
+volatile bool g_abort_released = false;  // 這次按下已釋放所有按鍵; ISR 在新的按下時清除
+volatile bool g_log_enabled = LOG_AVAILABLE;  // 日誌啟用狀態
+volatile bool g_queue_paused = false;    // 佇列暫停狀態 (按鈕切換)
+volatile uint8_t g_button_pending = 0;   // 待 loop() 處理的按鈕動作 (bitmask)
+uint32_t button_last_press[MAX_BUTTON_BINDINGS];  // 防彈跳計時器
 
 // ========== 指令佇列結構 ==========
-#define QUEUE_SIZE 16
-
-struct CommandPacket {
-    uint8_t cmd;
-    uint8_t params[MAX_PACKET_SIZE];
-    uint8_t param_len;
-    uint32_t timestamp;  // 接收時間戳
-};
+// 變長封包存放在共用的位元組池, 接收狀態機直接寫入池中 (不另設 rx_buffer)
+// Entry: [STATE][LEN][CMD][PARAMS...][CRC 1 或 2 bytes]
+#define QUEUE_POOL_SIZE       640
+#define ENTRY_HEADER_SIZE     2
+
+#define ENTRY_RESERVED        0x01  // 接收中
+#define ENTRY_READY           0x02  // 等待執行
+#define ENTRY_DEAD            0x03  // 已丟棄, 等待回收
+#define ENTRY_WRAP            0x04  // 池尾標記: 讀取端跳回開頭
+#define ENTRY_STATE_MASK      0x0F
+#define ENTRY_CRC16           0x80  // CRC 佔 2 bytes
 
 class CommandQueue {
 private:
-    CommandPacket queue[QUEUE_SIZE];
-    volatile uint8_t head;
-    volatile uint8_t tail;
-    volatile uint8_t count;
+    uint8_t pool[QUEUE_POOL_SIZE];
+    uint16_t head;
+    uint16_t tail;
+    uint8_t count;  // 已配置的 entry 數 (含接收中)
+
+    uint16_t entrySize(uint16_t entry) const {
+        return ENTRY_HEADER_SIZE + pool[entry + 1] + ((pool[entry] & ENTRY_CRC16) ? 2 : 1);
+    }
+
+    void setState(uint16_t entry, uint8_t state) {
+        pool[entry] = (pool[entry] & ~ENTRY_STATE_MASK) | state;
+    }
 
 public:
     CommandQueue() : head(0), tail(0), count(0) {}
 
-    bool push(const CommandPacket& packet) {
-        if (count >= QUEUE_SIZE) {
-            return false;  // 佇列滿了
+    // 配置一個連續的 entry, 回傳 entry 位置; 空間不足回傳 -1
+    int16_t reserve(uint8_t len, bool crc16) {
+        uint16_t need = ENTRY_HEADER_SIZE + len + (crc16 ? 2 : 1);
+        uint16_t entry;
+
+        if (count == 0) {
+            head = tail = 0;
+        } else if (tail == head) {
+            return -1;  // 佇列滿了
+        }
+
+        if (tail >= head) {
+            if (QUEUE_POOL_SIZE - tail >= need) {
+                entry = tail;
+            } else if (head >= need) {
+                if (tail < QUEUE_POOL_SIZE) pool[tail] = ENTRY_WRAP;
+                entry = 0;
+            } else {
+                return -1;
+            }
+        } else if (head - tail >= need) {
+            entry = tail;
+        } else {
+            return -1;
         }
-        queue[tail] = packet;
-        tail = (tail + 1) % QUEUE_SIZE;
+
+        pool[entry] = ENTRY_RESERVED | (crc16 ? ENTRY_CRC16 : 0);
+        pool[entry + 1] = len;
+        tail = entry + need;
         count++;
-        return true;
+        return entry;
+    }
+
+    // 回傳 [LEN][DATA][CRC] 的起點
+    uint8_t* frame(int16_t entry) { return pool + entry + 1; }
+
+    void commit(int16_t entry) { setState(entry, ENTRY_READY); }
+
+    void discard(int16_t entry) {
+        if (entry + entrySize(entry) == tail) {
+            // 最後配置的 entry 直接退回
+            tail = entry;
+            if (--count == 0) head = tail = 0;
+        } else {
+            setState(entry, ENTRY_DEAD);
+        }
     }
 
-    bool pop(CommandPacket& packet) {
+    // 取得最前面可執行的 entry (不複製), 執行完後呼叫 pop()
+    bool peek(const uint8_t*& data, uint8_t& len) {
+        while (count > 0) {
+            uint8_t state = pool[head] & ENTRY_STATE_MASK;
+            if (state == ENTRY_DEAD) {
+                pop();
+                continue;
+            }
+            if (state != ENTRY_READY) {
+                return false;  // 接收中, 等待
+            }
+            len = pool[head + 1];
+            data = pool + head + ENTRY_HEADER_SIZE;
+            return true;
+        }
+        return false;
+    }
+
+    void pop() {
         if (count == 0) {
-            return false;  // 佇列空了
+            return;  // 佇列空了
+        }
+        head += entrySize(head);
+        if (--count == 0) {
+            head = tail = 0;
+        } else if (head >= QUEUE_POOL_SIZE || pool[head] == ENTRY_WRAP) {
+            head = 0;
         }
-        packet = queue[head];
-        head = (head + 1) % QUEUE_SIZE;
-        count--;
-        return true;
     }
 
+    // 接收中的 entry 保留, 其餘全部丟棄
     void clear() {
-        head = tail = count = 0;
+        uint16_t pos = head;
+        for (uint8_t i = 0; i < count; i++) {
+            if (pos >= QUEUE_POOL_SIZE || pool[pos] == ENTRY_WRAP) pos = 0;
+            if ((pool[pos] & ENTRY_STATE_MASK) == ENTRY_READY) setState(pos, ENTRY_DEAD);
+            pos += entrySize(pos);
+        }
     }
 
     uint8_t size() const { return count; }
+    uint16_t bytesUsed() const {
+        if (count == 0) return 0;
+        return (tail > head) ? tail - head : QUEUE_POOL_SIZE - head + tail;
+    }
     bool isEmpty() const { return count == 0; }
-    bool isFull() const { return count >= QUEUE_SIZE; }
 };
 
 CommandQueue cmdQueue;
 
+// ========== 巨集 (儲存於 Flash) ==========
+// 格式: [LEN][CMD][PARAMS...] 重複, 以 LEN = 0 結尾 (LEN = CMD + PARAMS 長度)
+const uint8_t MACRO_SLOT_0[] PROGMEM = {
+    2, CMD_KB_WRITE, 0xB1,                // ESC
+    0
+};
+
+const uint8_t MACRO_SLOT_1[] PROGMEM = {
+    2, CMD_MOUSE_CLICK, 0x01,             // 左鍵點擊
+    0
+};
+
+const uint8_t* const MACRO_SLOTS[] = { MACRO_SLOT_0, MACRO_SLOT_1 };
+#define MACRO_SLOT_COUNT (sizeof(MACRO_SLOTS) / sizeof(MACRO_SLOTS[0]))
+
 // ========== CRC-8 查找表 ==========
 const PROGMEM uint8_t CRC8_TABLE[256] = {
     0x00, 0x5E, 0xBC, 0xE2, 0x61, 0x3F, 0xDD, 0x83,
@@ -125,6 +302,89 @@ const PROGMEM uint8_t CRC8_TABLE[256] = {
     0xB6, 0xE8, 0x0A, 0x54, 0xD7, 0x89, 0x6B, 0x35
 };
 
+// ========== CRC-16/CCITT 查找表 (poly 0x1021, init 0xFFFF) ==========
+const PROGMEM uint16_t CRC16_TABLE[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
+};
+
+// ========== 記憶體監測 ==========
+// 開機時把 heap 尾端到 RAMEND 塗上 STACK_CANARY, stack 用過的位置會被改寫,
+// 由低位址往上掃描第一個被改寫的位元組即為 stack 曾到達的最深處 (high-water mark)
+#define STACK_CANARY          0xC5
+
+extern char __heap_start;  // linker: .bss 結尾
+extern char *__brkval;     // avr-libc malloc: 目前 heap 頂端 (未使用時為 0)
+
+#define STRINGIFY_(x)         #x
+#define STRINGIFY(x)          STRINGIFY_(x)
+
+// 在 .init3 執行 (stack 已設定, C++ 建構子與 .data/.bss 初始化之前), 不能有 call / return
+// naked 函式只能安全地使用 basic asm, 所以迴圈直接以組合語言撰寫 (Z = __heap_start ~ RAMEND)
+void paintStack() __attribute__((naked, used, section(".init3")));
+void paintStack() {
+    __asm__ volatile (
+        "    ldi r30, lo8(__heap_start)\n"
+        "    ldi r31, hi8(__heap_start)\n"
+        "    ldi r24, " STRINGIFY(STACK_CANARY) "\n"
+        "    ldi r25, hi8(" STRINGIFY(RAMEND) " + 1)\n"
+        "1:  st Z+, r24\n"
+        "    cpi r30, lo8(" STRINGIFY(RAMEND) " + 1)\n"
+        "    cpc r31, r25\n"
+        "    brne 1b\n"
+    );
+}
+
+// heap 尾端 (本程式不使用 malloc, 通常等於 __heap_start)
+uint8_t *heapEnd() {
+    return (uint8_t *)(__brkval ? __brkval : &__heap_start);
+}
+
+// 目前 heap 與 stack 之間的剩餘空間
+uint16_t freeMemory() {
+    uint8_t top;
+    return &top - heapEnd();
+}
+
+// 開機以來最少的剩餘空間 (仍保持 STACK_CANARY 的位元組數)
+uint16_t minFreeMemory() {
+    const uint8_t *p = heapEnd();
+    while (p <= (const uint8_t *)RAMEND && *p == STACK_CANARY) {
+        p++;
+    }
+    return p - heapEnd();
+}
+
 // ========== 日誌系統 (改良版) ==========
 #define LOG_LEVEL_INFO        0
 #define LOG_LEVEL_WARN        1
@@ -139,15 +399,18 @@ private:
     uint32_t error_counter = 0;
     uint32_t success_counter = 0;
 
+    // 中斷處理期間不寫日誌: Serial1 TX 緩衝區滿時 print 會阻塞, 拖慢按鍵釋放
+    bool logActive() const { return g_log_enabled && !g_interrupt_flag; }
+
     void printTimestamp() {
-        if (!g_log_enabled) return;
+        if (!logActive()) return;
         Serial1.print("[");
         Serial1.print(millis());
         Serial1.print("ms] ");
     }
 
     void printLevel(const char* level) {
-        if (!g_log_enabled) return;
+        if (!logActive()) return;
         Serial1.print("[");
         Serial1.print(level);
         Serial1.print("] ");
@@ -170,17 +433,19 @@ public:
     }
 
     void logQueueStatus() {
-        if (!g_log_enabled || CURRENT_LOG_LEVEL < LOG_LEVEL_DEBUG) return;
+        if (!logActive() || CURRENT_LOG_LEVEL < LOG_LEVEL_DEBUG) return;
         printTimestamp();
         printLevel("QUEUE");
         Serial1.print("Size: ");
         Serial1.print(cmdQueue.size());
+        Serial1.print(" | Bytes: ");
+        Serial1.print(cmdQueue.bytesUsed());
         Serial1.print("/");
-        Serial1.println(QUEUE_SIZE);
+        Serial1.println(QUEUE_POOL_SIZE);
     }
 
     void logPacketReceived(uint8_t len) {
-        if (!g_log_enabled || CURRENT_LOG_LEVEL < LOG_LEVEL_DEBUG) return;
+        if (!logActive() || CURRENT_LOG_LEVEL < LOG_LEVEL_DEBUG) return;
         packet_counter++;
         printTimestamp();
         printLevel("RECV");
@@ -191,7 +456,7 @@ public:
     }
 
     void logPacketData(const uint8_t *data, uint8_t len) {
-        if (!g_log_enabled || CURRENT_LOG_LEVEL < LOG_LEVEL_DEBUG) return;
+        if (!logActive() || CURRENT_LOG_LEVEL < LOG_LEVEL_DEBUG) return;
         Serial1.print("    Data: ");
         for (uint8_t i = 0; i < len; i++) {
             if (data[i] < 0x10) Serial1.print("0");
@@ -202,7 +467,7 @@ public:
     }
 
     void logCommand(const char* cmd_name, const char* details = nullptr) {
-        if (!g_log_enabled) return;
+        if (!logActive()) return;
         printTimestamp();
         printLevel("EXEC");
         Serial1.print(cmd_name);
@@ -215,26 +480,42 @@ public:
 
     void logInterrupt() {
         // 中斷訊息永遠顯示
+        if (!LOG_AVAILABLE) return;
         printTimestamp();
         printLevel("INT");
         Serial1.println("❌ USER INTERRUPT - Clearing queue");
     }
 
+    void logEvent(uint8_t evt, uint8_t arg) {
+        if (!logActive()) return;
+        char buf[32];
+        snprintf(buf, sizeof(buf), "evt=0x%02X, arg=%d", evt, arg);
+        logCommand("EVENT", buf);
+    }
+
+    void logQueuePauseChange(bool paused) {
+        // 狀態變更永遠顯示
+        if (!LOG_AVAILABLE) return;
+        Serial1.print("\n[QUEUE] ");
+        Serial1.println(paused ? "⏸ Queue PAUSED" : "▶ Queue RESUMED");
+    }
+
     void logLogStateChange(bool enabled) {
         // 狀態變更永遠顯示
+        if (!LOG_AVAILABLE) return;
         Serial1.print("\n[LOG] ");
         Serial1.println(enabled ? "✓ Logging ENABLED" : "✗ Logging PAUSED");
     }
 
     void logMouseMove(int8_t x, int8_t y, int8_t wheel) {
-        if (!g_log_enabled) return;
+        if (!logActive()) return;
         char buf[64];
         snprintf(buf, sizeof(buf), "x=%d, y=%d, wheel=%d", x, y, wheel);
         logCommand("MOUSE_MOVE", buf);
     }
 
     void logMouseButton(const char* action, uint8_t button) {
-        if (!g_log_enabled) return;
+        if (!logActive()) return;
         char buf[64];
         const char* btn_name = getButtonName(button);
         snprintf(buf, sizeof(buf), "%s (%s)", action, btn_name);
@@ -242,7 +523,7 @@ public:
     }
 
     void logKeyboard(const char* action, uint8_t key) {
-        if (!g_log_enabled) return;
+        if (!logActive()) return;
         char buf[80];
         const char* key_name = getKeyName(key);
         snprintf(buf, sizeof(buf), "%s %s (0x%02X)", action, key_name, key);
@@ -250,7 +531,7 @@ public:
     }
 
     void logKeyboardPrint(const uint8_t *text, uint8_t len) {
-        if (!g_log_enabled) return;
+        if (!logActive()) return;
         Serial1.print("    Text: \"");
         for (uint8_t i = 0; i < len && i < 40; i++) {
             if (text[i] >= 32 && text[i] <= 126) {
@@ -266,7 +547,7 @@ public:
     }
 
     void logError(const char* error_type, const char* details = nullptr) {
-        if (!g_log_enabled) return;
+        if (!logActive()) return;
         error_counter++;
         printTimestamp();
         printLevel("ERROR");
@@ -279,29 +560,29 @@ public:
         Serial1.println(error_counter);
     }
 
-    void logCRCError(uint8_t expected, uint8_t received) {
-        if (!g_log_enabled) return;
+    void logCRCError(uint16_t expected, uint16_t received) {
+        if (!logActive()) return;
         char buf[64];
         snprintf(buf, sizeof(buf), "Expected: 0x%02X, Got: 0x%02X", expected, received);
         logError("CRC_MISMATCH", buf);
     }
 
     void logInvalidCommand(uint8_t cmd) {
-        if (!g_log_enabled) return;
+        if (!logActive()) return;
         char buf[32];
         snprintf(buf, sizeof(buf), "Unknown CMD: 0x%02X", cmd);
         logError("INVALID_CMD", buf);
     }
 
     void logParamError(uint8_t cmd, uint8_t expected, uint8_t received) {
-        if (!g_log_enabled) return;
+        if (!logActive()) return;
         char buf[64];
         snprintf(buf, sizeof(buf), "CMD 0x%02X needs %d bytes, got %d", cmd, expected, received);
         logError("PARAM_ERROR", buf);
     }
 
     void logACK(uint8_t ack_code) {
-        if (!g_log_enabled || CURRENT_LOG_LEVEL < LOG_LEVEL_DEBUG) return;
+        if (!logActive() || CURRENT_LOG_LEVEL < LOG_LEVEL_DEBUG) return;
 
         const char* ack_name;
         switch(ack_code) {
@@ -313,6 +594,7 @@ public:
             case ACK_INVALID_CMD: ack_name = "INVALID_CMD"; break;
             case ACK_PARAM_ERROR: ack_name = "PARAM_ERROR"; break;
             case ACK_INTERRUPTED: ack_name = "INTERRUPTED"; break;
+            case ACK_QUEUE_FULL: ack_name = "QUEUE_FULL"; break;
             default: ack_name = "UNKNOWN"; break;
         }
 
@@ -325,7 +607,7 @@ public:
     }
 
     void logStats() {
-        if (!g_log_enabled) return;
+        if (!logActive()) return;
         Serial1.println("\n--- Statistics ---");
         Serial1.print("Total Packets: ");
         Serial1.println(packet_counter);
@@ -335,6 +617,11 @@ public:
         Serial1.println(error_counter);
         Serial1.print("Queue Size: ");
         Serial1.println(cmdQueue.size());
+        Serial1.print("Free RAM: ");
+        Serial1.print(freeMemory());
+        Serial1.print(" (min ");
+        Serial1.print(minFreeMemory());
+        Serial1.println(")");
         Serial1.print("Success Rate: ");
         if (packet_counter > 0) {
             Serial1.print((success_counter * 100.0) / packet_counter, 2);
@@ -394,16 +681,48 @@ public:
 Logger logger;
 
 // ========== 中斷服務例程 (ISR) ==========
-void buttonISR() {
+// 不需要 Serial / 佇列的動作直接在 ISR 內完成, 其餘交給 loop()
+void onButtonEdge(uint8_t idx) {
+    const ButtonBinding& binding = BUTTON_BINDINGS[idx];
     uint32_t current_time = millis();
-    
+
     // 防彈跳
-    if (current_time - last_button_press > BUTTON_DEBOUNCE_MS) {
-        g_interrupt_flag = true;
-        last_button_press = current_time;
+    if (current_time - button_last_press[idx] <= binding.debounce_ms) {
+        return;
+    }
+    button_last_press[idx] = current_time;
+
+    switch (binding.action) {
+        case BTN_ACTION_ABORT:
+            // 旗標尚未清除但已釋放 (loop() 收尾前): 視為新的一次中斷, 重新計時
+            if (!g_interrupt_flag || g_abort_released) {
+                g_abort_start_us = micros();
+                g_abort_released = false;
+            }
+            g_interrupt_flag = true;
+            break;
+        case BTN_ACTION_PAUSE_QUEUE:
+            g_queue_paused = !g_queue_paused;
+            break;
+        default:
+            g_button_pending |= (1 << idx);
+            break;
     }
 }
 
+// attachInterrupt 不能帶參數, 每組綁定各一個 ISR
+template <uint8_t IDX>
+void buttonISR() {
+    onButtonEdge(IDX);
+}
+
+typedef void (*ButtonISR)();
+const ButtonISR BUTTON_ISRS[MAX_BUTTON_BINDINGS] = {
+    buttonISR<0>, buttonISR<1>, buttonISR<2>, buttonISR<3>
+};
+
+static_assert(BUTTON_COUNT <= MAX_BUTTON_BINDINGS, "Too many button bindings");
+
 // ========== CRC 計算 ==========
 uint8_t crc8(const uint8_t *data, uint8_t len) {
     uint8_t crc = 0x00;
@@ -413,17 +732,195 @@ uint8_t crc8(const uint8_t *data, uint8_t len) {
     return crc;
 }
 
+uint16_t crc16Update(uint16_t crc, const uint8_t *data, uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+        crc = (crc << 8) ^ pgm_read_word(&CRC16_TABLE[(crc >> 8) ^ data[i]]);
+    }
+    return crc;
+}
+
+uint16_t crc16(const uint8_t *data, uint16_t len) {
+    return crc16Update(0xFFFF, data, len);
+}
+
 // ========== 封包處理 ==========
-uint8_t rx_buffer[MAX_PACKET_SIZE];
-uint8_t rx_state = 0;
-uint8_t rx_len = 0;
-uint8_t rx_idx = 0;
+// 每個輸入埠 (USB CDC, COMMAND 模式下加上 Serial1) 各有一個接收狀態機,
+// 共用同一個指令佇列與執行器; ACK 與回應封包送回收到封包的那個埠
+// 佇列滿時, 短封包 (立即指令) 改收到 scratch, 確保 CLEAR_QUEUE 等仍可執行
+#define RX_SCRATCH_SIZE       16
+// 封包接收中超過這段時間沒有新資料就丟棄 (避免未完成的 entry 卡在佇列前端,
+// 或 LEN 損毀時預留的大 entry 吞掉後面的封包)
+// 兩個埠共用佇列, 一個埠卡住的 entry 也會擋住另一個埠的指令, 所以每個埠依自身速率設定
+#define RX_FRAME_TIMEOUT_MS   10  // USB CDC
+// 佇列滿 (或 CRC 錯誤) 拒收一個封包後, 同一埠之後要進佇列的封包一律拒收,
+// 直到 Host 重送被拒收的那個封包; 否則較小的後續封包會先進佇列, 打亂執行順序
+// Host 放棄重送時, 超過這段時間自動解除
+#define QUEUE_HOLD_MS         50
+
+struct RxChannel {
+    Stream *port;
+    uint8_t scratch[1 + RX_SCRATCH_SIZE + 2];  // [LEN][DATA][CRC]
+    uint8_t *frame;   // [LEN][DATA][CRC], nullptr: 丟棄資料
+    int16_t entry;    // 佇列 entry, -1: 使用 scratch
+    uint8_t state;    // 0 SYNC / 1 LEN / 2 DATA + CRC / 3 SINK / 4 封包已收完, 等待 loop() 處理
+    bool crc16;
+    uint8_t len;
+    uint16_t idx;
+    uint16_t need;
+    uint8_t timeout_ms;     // 封包接收逾時
+    uint32_t last_byte_ms;  // 最後收到資料的時間
+    uint16_t crc_in;        // 最後收到的 2 bytes, 封包收完時即為 CRC (資料被丟棄時也有)
+    bool hold;              // 拒收中, 等待被拒收的封包重送
+    uint8_t hold_len;       // 被拒收封包的 LEN 與 CRC
+    uint16_t hold_crc;
+    uint32_t hold_ms;
+};
+
+RxChannel rxUsb = {&Serial, {0}, nullptr, -1, 0, false, 0, 0, 0, RX_FRAME_TIMEOUT_MS, 0, 0, false, 0, 0, 0};
+#if SERIAL1_MODE == SERIAL1_MODE_COMMAND
+RxChannel rxUart = {&Serial1, {0}, nullptr, -1, 0, false, 0, 0, 0, SERIAL1_RX_TIMEOUT_MS, 0, 0, false, 0, 0, 0};
+RxChannel *const RX_CHANNELS[] = {&rxUsb, &rxUart};
+#else
+RxChannel *const RX_CHANNELS[] = {&rxUsb};
+#endif
+#define RX_CHANNEL_COUNT      (sizeof(RX_CHANNELS) / sizeof(RX_CHANNELS[0]))
+
+RxChannel *rx_reply = &rxUsb;  // 目前處理中封包的來源
+bool pollAbort();              // 耗時指令執行中呼叫 (定義在封包接收狀態機之後)
+
+// ========== 鏈路自我測試 (CMD_SINK) ==========
+// 丟棄原始資料, 只計數與計時, 用來量測 USB CDC 本身的頻寬
+#define SINK_TIMEOUT_MS       1000
+
+struct SinkState {
+    uint32_t total;           // 預期 bytes, 0 表示未啟動
+    uint32_t received;
+    uint32_t start_us;
+    uint32_t end_us;
+    uint32_t progress_count;
+    uint32_t progress_ms;
+    RxChannel *channel;       // 送出 CMD_SINK 的埠
+} sink = {0, 0, 0, 0, 0, 0, &rxUsb};
 
 void sendAck(uint8_t ack_code) {
-    Serial.write(ack_code);
+    rx_reply->port->write(ack_code);
+    logger.logACK(ack_code);
+}
+
+// 非回覆特定封包的 ACK (例如 ACK_INTERRUPTED), 送到所有埠
+void broadcastAck(uint8_t ack_code) {
+    for (uint8_t i = 0; i < RX_CHANNEL_COUNT; i++) {
+        RX_CHANNELS[i]->port->write(ack_code);
+    }
     logger.logACK(ack_code);
 }
 
+void sendResponse(const uint8_t *data, uint8_t len) {
+    uint8_t header[2] = {RESP_MARKER, len};
+    uint16_t crc = crc16Update(crc16(&header[1], 1), data, len);
+    uint8_t trailer[2] = {(uint8_t)(crc >> 8), (uint8_t)(crc & 0xFF)};
+    rx_reply->port->write(header, sizeof(header));
+    rx_reply->port->write(data, len);
+    rx_reply->port->write(trailer, sizeof(trailer));
+}
+
+void sendEvent(uint8_t evt, uint8_t arg) {
+    uint8_t frame[3] = {EVT_MARKER, evt, arg};
+    Serial.write(frame, sizeof(frame));
+    logger.logEvent(evt, arg);
+}
+
+// 回應: [RECEIVED u32][ELAPSED_US u32], 逾時結束時 RECEIVED < 預期
+void finishSink() {
+    uint32_t elapsed = sink.received ? sink.end_us - sink.start_us : 0;
+    uint8_t result[8] = {
+        (uint8_t)(sink.received >> 24), (uint8_t)(sink.received >> 16),
+        (uint8_t)(sink.received >> 8), (uint8_t)sink.received,
+        (uint8_t)(elapsed >> 24), (uint8_t)(elapsed >> 16),
+        (uint8_t)(elapsed >> 8), (uint8_t)elapsed
+    };
+    RxChannel *reply = rx_reply;
+    rx_reply = sink.channel;
+    sendResponse(result, sizeof(result));
+    rx_reply = reply;
+    logger.logCommand("SINK_DONE");
+    sink.total = 0;
+    sink.channel->state = 0;
+}
+
+void serviceSinkTimeout() {
+    if (sink.received != sink.progress_count) {
+        sink.progress_count = sink.received;
+        sink.progress_ms = millis();
+        sink.end_us = micros();
+    } else if (millis() - sink.progress_ms > SINK_TIMEOUT_MS) {
+        logger.logError("SINK_TIMEOUT");
+        finishSink();
+    }
+}
+
+// ========== 壓縮文字 (CMD_KB_PRINT_Z) ==========
+// PARAMS: [FLAGS][TOKENS...], FLAGS bit0 = 新文字 (清空視窗)
+// TOKEN:
+//   0LLLLLLL            L+1 (1~128) 個字元原樣輸出, 後接字元
+//   10LLLLLL [CHAR]     CHAR 重複 L+3 (3~66) 次
+//   11LLLLLL [DIST-1]   從 DIST (1~128) 個字元之前複製 L+3 (3~66) 個字元, 可重疊
+// 視窗保留最近輸出的 128 個字元, 跨封包延續, 所以一段長文字可以分成多個封包
+#define Z_WINDOW_SIZE         128  // 必須是 2 的冪次
+#define Z_FLAG_RESET          0x01
+
+struct ZWindow {
+    uint8_t buf[Z_WINDOW_SIZE];
+    uint8_t pos;     // 下一個寫入位置
+    uint8_t filled;  // 有效字元數 (最多 Z_WINDOW_SIZE)
+} zWindow = {{0}, 0, 0};
+
+void zEmit(uint8_t c) {
+    Keyboard.write(c);
+    zWindow.buf[zWindow.pos] = c;
+    zWindow.pos = (zWindow.pos + 1) & (Z_WINDOW_SIZE - 1);
+    if (zWindow.filled < Z_WINDOW_SIZE) zWindow.filled++;
+}
+
+// 回傳 false 表示格式錯誤 (被中斷時提早結束但回傳 true)
+bool decodePrintZ(const uint8_t *params, uint8_t param_len) {
+    if (params[0] & Z_FLAG_RESET) {
+        zWindow.pos = 0;
+        zWindow.filled = 0;
+    }
+    uint8_t i = 1;
+    while (i < param_len) {
+        uint8_t token = params[i++];
+        uint8_t count;
+        if (token < 0x80) {
+            count = token + 1;
+            if (param_len - i < count) return false;
+            while (count--) {
+                if (pollAbort()) return true;  // 可中斷的輸入
+                zEmit(params[i++]);
+            }
+            continue;
+        }
+        if (i >= param_len) return false;
+        uint8_t arg = params[i++];
+        count = (token & 0x3F) + 3;
+        if (token < 0xC0) {
+            while (count--) {
+                if (pollAbort()) return true;
+                zEmit(arg);
+            }
+        } else {
+            uint16_t dist = (uint16_t)arg + 1;
+            if (dist > zWindow.filled) return false;
+            while (count--) {
+                if (pollAbort()) return true;
+                zEmit(zWindow.buf[(zWindow.pos - dist) & (Z_WINDOW_SIZE - 1)]);
+            }
+        }
+    }
+    return true;
+}
+
 // ========== 非阻塞式指令執行 ==========
 struct TimedAction {
     bool active;
@@ -433,14 +930,131 @@ struct TimedAction {
     uint16_t duration_ms;
 } timedAction = {false, 0, 0, 0, 0};
 
-void executeCommand(const CommandPacket& packet) {
-    uint8_t cmd = packet.cmd;
-    const uint8_t *params = packet.params;
-    uint8_t param_len = packet.param_len;
+// CMD_MOUSE_DRAG: 按下後等待 press_settle, 在 duration 內平均送出總位移, 再等待 release_settle 後放開
+// 執行期間佇列暫停 (與計時動作相同), 中斷時由 releaseAllInputs() 一併取消並放開
+#define DRAG_PRESS_SETTLE     0
+#define DRAG_MOVING           1
+#define DRAG_RELEASE_SETTLE   2
 
+struct DragTask {
+    bool active;
+    uint8_t phase;
+    uint8_t button;
+    int16_t dx, dy;          // 總位移 (HID counts)
+    int16_t sent_x, sent_y;  // 已送出的位移
+    uint16_t duration_ms;
+    uint16_t press_settle_ms;
+    uint16_t release_settle_ms;
+    uint32_t phase_start;
+} dragTask = {false, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+int8_t clampStep(int16_t v) {
+    return v > 127 ? 127 : (v < -127 ? -127 : v);
+}
+
+// 每次 loop() 最多送出一個 report
+void serviceDrag() {
+    uint32_t elapsed = millis() - dragTask.phase_start;
+    switch (dragTask.phase) {
+        case DRAG_PRESS_SETTLE:
+            if (elapsed < dragTask.press_settle_ms) return;
+            dragTask.phase = DRAG_MOVING;
+            dragTask.phase_start = millis();
+            elapsed = 0;
+            // fall through
+        case DRAG_MOVING: {
+            int16_t target_x = dragTask.dx;
+            int16_t target_y = dragTask.dy;
+            if (elapsed < dragTask.duration_ms) {
+                // 全部以有號數計算: 混入 uint32_t 會讓負位移變成無號數運算
+                int32_t t = (int32_t)elapsed;
+                int32_t d = (int32_t)dragTask.duration_ms;
+                target_x = (int32_t)dragTask.dx * t / d;
+                target_y = (int32_t)dragTask.dy * t / d;
+            }
+            int8_t step_x = clampStep(target_x - dragTask.sent_x);
+            int8_t step_y = clampStep(target_y - dragTask.sent_y);
+            if (step_x || step_y) {
+                Mouse.move(step_x, step_y, 0);
+                dragTask.sent_x += step_x;
+                dragTask.sent_y += step_y;
+            }
+            if (dragTask.sent_x == dragTask.dx && dragTask.sent_y == dragTask.dy &&
+                elapsed >= dragTask.duration_ms) {
+                dragTask.phase = DRAG_RELEASE_SETTLE;
+                dragTask.phase_start = millis();
+            }
+            break;
+        }
+        case DRAG_RELEASE_SETTLE:
+            if (elapsed < dragTask.release_settle_ms) return;
+            Mouse.release(dragTask.button);
+            dragTask.active = false;
+            logger.logCommand("MOUSE_DRAG_END");
+            break;
+    }
+}
+
+// ========== 中斷延遲 ==========
+// 中斷按鈕 ISR 只設旗標; 耗時指令每個 report 前經由 pollAbort() 檢查,
+// 所以釋放最晚發生在一個 USB report (或一個短指令) 之後, 不必等回到 loop()
+// 量測 ISR 到釋放完成 (最後一個 release report 送出) 的時間
+#define ABORT_BOUND_US        5000  // 目標上限, 超過時計入 over_bound
+
+struct AbortStats {
+    uint16_t count;
+    uint16_t over_bound;
+    uint32_t last_us;
+    uint32_t max_us;
+} abortStats = {0, 0, 0, 0};
+
+// 釋放所有按鍵 / 按鈕 (同一次中斷只執行一次)
+void releaseAllInputs() {
+    if (g_abort_released) return;
+    Keyboard.releaseAll();
+    Mouse.release(MOUSE_LEFT | MOUSE_RIGHT | MOUSE_MIDDLE);
+
+    // 清除計時動作
+    if (timedAction.active) {
+        if (timedAction.action_type == 0) {
+            Mouse.release(timedAction.button_or_key);
+        } else {
+            Keyboard.release(timedAction.button_or_key);
+        }
+        timedAction.active = false;
+    }
+    // 拖曳可能使用 L / R / M 以外的按鍵 (X1 / X2), 明確放開
+    if (dragTask.active) {
+        Mouse.release(dragTask.button);
+        dragTask.active = false;
+    }
+
+    // g_abort_released 為 false 且旗標已設定時 ISR 不會寫入 g_abort_start_us
+    uint32_t elapsed = micros() - g_abort_start_us;
+    abortStats.count++;
+    abortStats.last_us = elapsed;
+    if (elapsed > abortStats.max_us) abortStats.max_us = elapsed;
+    if (elapsed > ABORT_BOUND_US) abortStats.over_bound++;
+    g_abort_released = true;  // 釋放途中的按下視為同一次中斷
+}
+
+// 依 HID modifier 位元差異按下 / 放開 modifier (usage 0xE0 + bit)
+void applyModifiers(uint8_t held, uint8_t wanted) {
+    uint8_t changed = held ^ wanted;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+        if (!(changed & (1 << bit))) continue;
+        if (wanted & (1 << bit)) {
+            Keyboard.pressRaw(0xE0 + bit);
+        } else {
+            Keyboard.releaseRaw(0xE0 + bit);
+        }
+    }
+}
+
+void executeCommand(uint8_t cmd, const uint8_t *params, uint8_t param_len) {
     // 檢查中斷旗標
     if (g_interrupt_flag) {
-        logger.logCommand("CMD_SKIPPED", "Interrupted");
+        releaseAllInputs();
         return;
     }
 
@@ -496,6 +1110,29 @@ void executeCommand(const CommandPacket& packet) {
             break;
         }
 
+        // PARAMS: [BUTTON][DX i16][DY i16][DURATION_MS u16][PRESS_SETTLE_MS u16][RELEASE_SETTLE_MS u16]
+        case CMD_MOUSE_DRAG: {
+            if (param_len != 11) {
+                logger.logParamError(cmd, 11, param_len);
+                return;
+            }
+            dragTask.button = params[0];
+            dragTask.dx = (int16_t)((params[1] << 8) | params[2]);
+            dragTask.dy = (int16_t)((params[3] << 8) | params[4]);
+            dragTask.duration_ms = (params[5] << 8) | params[6];
+            dragTask.press_settle_ms = (params[7] << 8) | params[8];
+            dragTask.release_settle_ms = (params[9] << 8) | params[10];
+            dragTask.sent_x = 0;
+            dragTask.sent_y = 0;
+            dragTask.phase = DRAG_PRESS_SETTLE;
+            dragTask.phase_start = millis();
+            dragTask.active = true;
+
+            Mouse.press(dragTask.button);
+            logger.logCommand("MOUSE_DRAG_START");
+            break;
+        }
+
         case CMD_KB_PRESS: {
             if (param_len != 1) return;
             logger.logKeyboard("Press", params[0]);
@@ -527,12 +1164,47 @@ void executeCommand(const CommandPacket& packet) {
             logger.logCommand("KB_PRINT");
             logger.logKeyboardPrint(params, param_len);
             for (uint8_t i = 0; i < param_len; i++) {
-                if (g_interrupt_flag) break;  // 可中斷的輸入
+                if (pollAbort()) break;  // 可中斷的輸入
                 Keyboard.write(params[i]);
             }
             break;
         }
 
+        case CMD_KB_PRINT_Z: {
+            if (param_len < 2) {
+                logger.logParamError(cmd, 2, param_len);
+                return;
+            }
+            logger.logCommand("KB_PRINT_Z");
+            if (!decodePrintZ(params, param_len)) {
+                zWindow.filled = 0;  // 後續封包的參照已不可信
+                logger.logError("KB_PRINT_Z", "Bad token");
+            }
+            break;
+        }
+
+        // PARAMS: N x [MOD][USAGE], MOD 為 HID modifier 位元 (bit0 左 Ctrl ... bit6 右 Alt)
+        // 相同 MOD 的連續字元不重複切換 modifier, 結束時放開所有 modifier
+        case CMD_KB_USAGES: {
+            if (param_len == 0 || (param_len & 1)) {
+                logger.logParamError(cmd, 2, param_len);
+                return;
+            }
+            logger.logCommand("KB_USAGES");
+            uint8_t held = 0;
+            for (uint8_t i = 0; i < param_len; i += 2) {
+                if (pollAbort()) break;  // 可中斷的輸入
+                applyModifiers(held, params[i]);
+                held = params[i];
+                if (params[i + 1]) {
+                    Keyboard.pressRaw(params[i + 1]);
+                    Keyboard.releaseRaw(params[i + 1]);
+                }
+            }
+            applyModifiers(held, 0);
+            break;
+        }
+
         case CMD_KB_PRESS_TIMED: {
             if (param_len != 3) return;
             uint8_t key = params[0];
@@ -557,7 +1229,7 @@ void executeCommand(const CommandPacket& packet) {
         }
 
         case CMD_RESUME_LOG: {
-            g_log_enabled = true;
+            g_log_enabled = LOG_AVAILABLE;
             logger.logLogStateChange(true);
             break;
         }
@@ -568,44 +1240,369 @@ void executeCommand(const CommandPacket& packet) {
             break;
         }
 
+        case CMD_GET_CAPS: {
+            uint8_t caps[5] = {
+                PROTOCOL_VERSION,
+                FEATURE_FRAME_V2 | FEATURE_LOOPBACK | FEATURE_MEMINFO |
+                    FEATURE_KB_USAGES | FEATURE_KB_PRINT_Z | FEATURE_ABORT_STATS |
+                    FEATURE_MOUSE_DRAG |
+                    (SERIAL1_MODE == SERIAL1_MODE_COMMAND ? FEATURE_SERIAL1_CMD : 0),
+                MAX_PAYLOAD_V2,
+                (uint8_t)(QUEUE_POOL_SIZE >> 8),
+                (uint8_t)(QUEUE_POOL_SIZE & 0xFF)
+            };
+            sendResponse(caps, sizeof(caps));
+            logger.logCommand("GET_CAPS");
+            break;
+        }
+
+        // 回應: [RAM u16][STATIC u16][FREE u16][FREE_MIN u16][STACK_MAX u16][N]
+        //       + N x [MEM_ID][SIZE u16], 全部 big-endian
+        case CMD_GET_MEMINFO: {
+            const uint16_t sizes[][2] = {
+                {MEM_ID_QUEUE, sizeof(cmdQueue)},
+                {MEM_ID_RX_CHANNELS, sizeof(rxUsb) * RX_CHANNEL_COUNT},
+                {MEM_ID_LOGGER, sizeof(logger)},
+                {MEM_ID_TIMED_ACTION, sizeof(timedAction) + sizeof(dragTask)},
+                {MEM_ID_BUTTONS, sizeof(button_last_press)},
+                {MEM_ID_SINK, sizeof(sink)},
+                {MEM_ID_SERIAL1, sizeof(Serial1)},
+                {MEM_ID_Z_WINDOW, sizeof(zWindow)},
+            };
+            const uint8_t count = sizeof(sizes) / sizeof(sizes[0]);
+            uint16_t free_min = minFreeMemory();
+            uint16_t header[5] = {
+                RAMEND - RAMSTART + 1,
+                (uint16_t)((uint8_t *)&__heap_start - (uint8_t *)RAMSTART),
+                freeMemory(),
+                free_min,
+                (uint16_t)((uint8_t *)RAMEND - heapEnd() + 1 - free_min)
+            };
+            uint8_t info[sizeof(header) + 1 + sizeof(sizes) / 4 * 3];
+            uint8_t n = 0;
+            for (uint8_t i = 0; i < 5; i++) {
+                info[n++] = header[i] >> 8;
+                info[n++] = header[i] & 0xFF;
+            }
+            info[n++] = count;
+            for (uint8_t i = 0; i < count; i++) {
+                info[n++] = sizes[i][0];
+                info[n++] = sizes[i][1] >> 8;
+                info[n++] = sizes[i][1] & 0xFF;
+            }
+            sendResponse(info, n);
+            logger.logCommand("GET_MEMINFO");
+            break;
+        }
+
+        // 回應: [COUNT u16][OVER_BOUND u16][LAST_US u32][MAX_US u32][BOUND_US u32], big-endian
+        case CMD_GET_ABORT_STATS: {
+            const uint32_t values[5] = {
+                abortStats.count, abortStats.over_bound,
+                abortStats.last_us, abortStats.max_us, ABORT_BOUND_US
+            };
+            const uint8_t widths[5] = {2, 2, 4, 4, 4};
+            uint8_t info[16];
+            uint8_t n = 0;
+            for (uint8_t i = 0; i < 5; i++) {
+                for (int8_t shift = (widths[i] - 1) * 8; shift >= 0; shift -= 8) {
+                    info[n++] = (uint8_t)(values[i] >> shift);
+                }
+            }
+            sendResponse(info, n);
+            logger.logCommand("GET_ABORT_STATS");
+            break;
+        }
+
+        case CMD_ECHO: {
+            sendResponse(params, param_len);
+            break;
+        }
+
+        case CMD_SINK: {
+            if (param_len != 4) {
+                logger.logParamError(cmd, 4, param_len);
+                return;
+            }
+            if (sink.total && sink.channel != rx_reply) {
+                // 另一個埠正在 SINK, 回報收到 0 bytes
+                uint8_t busy[8] = {0};
+                sendResponse(busy, sizeof(busy));
+                logger.logError("SINK_BUSY");
+                return;
+            }
+            sink.channel = rx_reply;
+            sink.total = ((uint32_t)params[0] << 24) | ((uint32_t)params[1] << 16) |
+                         ((uint32_t)params[2] << 8) | params[3];
+            sink.received = 0;
+            sink.progress_count = 0;
+            sink.progress_ms = millis();
+            logger.logCommand("SINK_START");
+            if (sink.total == 0) finishSink();
+            break;
+        }
+
         default:
             logger.logInvalidCommand(cmd);
             break;
     }
 }
 
-void processPacket(const uint8_t *data, uint8_t len) {
-    if (len < 1) {
-        logger.logError("EMPTY_PACKET");
-        sendAck(ACK_PARAM_ERROR);
-        return;
-    }
+bool isImmediateCommand(uint8_t cmd) {
+    return cmd == CMD_PAUSE_LOG ||
+           cmd == CMD_RESUME_LOG ||
+           cmd == CMD_CLEAR_QUEUE ||
+           cmd == CMD_GET_CAPS ||
+           cmd == CMD_GET_MEMINFO ||
+           cmd == CMD_GET_ABORT_STATS ||
+           cmd == CMD_ECHO ||
+           cmd == CMD_SINK;
+}
 
+// data 指向 frame 內的 DATA, entry 為 -1 時表示資料在 scratch
+void processPacket(const uint8_t *data, uint8_t len, int16_t entry) {
     logger.logPacketData(data, len);
 
-    // 封裝成 CommandPacket
-    CommandPacket packet;
-    packet.cmd = data[0];
-    packet.param_len = len - 1;
-    memcpy(packet.params, data + 1, packet.param_len);
-    packet.timestamp = millis();
-
-    // 立即執行的指令
-    if (packet.cmd == CMD_PAUSE_LOG || 
-        packet.cmd == CMD_RESUME_LOG || 
-        packet.cmd == CMD_CLEAR_QUEUE) {
-        executeCommand(packet);
+    // 立即執行的指令 (先 ACK, 回應封包緊接在後)
+    if (isImmediateCommand(data[0])) {
         sendAck(ACK_SUCCESS);
+        executeCommand(data[0], data + 1, len - 1);
+        if (entry >= 0) cmdQueue.discard(entry);
         return;
     }
 
-    // 加入佇列
-    if (cmdQueue.push(packet)) {
-        logger.logQueueStatus();
-        sendAck(ACK_SUCCESS);
+    // 加入佇列 (資料已在池中, 只需標記為可執行; 佇列滿的封包已由 finishFrame 拒收)
+    cmdQueue.commit(entry);
+    logger.logQueueStatus();
+    sendAck(ACK_SUCCESS);
+}
+
+// 拒收封包, 並記住第一個被拒收的封包 (之後的封包拒收到它重送為止)
+void rejectFrame(RxChannel &ch, uint16_t rx_crc, uint8_t ack_code) {
+    if (ch.entry >= 0) cmdQueue.discard(ch.entry);
+    if (!ch.hold) {
+        ch.hold = true;
+        ch.hold_len = ch.len;
+        ch.hold_crc = rx_crc;
+        ch.hold_ms = millis();
+    }
+    sendAck(ack_code);
+}
+
+void finishFrame(RxChannel &ch) {
+    uint16_t rx_crc = ch.crc16 ? ch.crc_in : (ch.crc_in & 0xFF);
+    if (ch.hold && ((ch.len == ch.hold_len && rx_crc == ch.hold_crc) ||
+                    millis() - ch.hold_ms >= QUEUE_HOLD_MS)) {
+        ch.hold = false;
+    }
+
+    if (ch.frame == nullptr) {
+        logger.logError("QUEUE_FULL", "Frame dropped");
+        rejectFrame(ch, rx_crc, ACK_QUEUE_FULL);
+        return;
+    }
+
+    bool crc_ok;
+    if (ch.crc16) {
+        uint16_t received_crc = ((uint16_t)ch.frame[1 + ch.len] << 8) | ch.frame[2 + ch.len];
+        uint16_t calculated_crc = crc16(ch.frame, 1 + ch.len);
+        crc_ok = received_crc == calculated_crc;
+        if (!crc_ok) logger.logCRCError(calculated_crc, received_crc);
     } else {
+        uint8_t received_crc = ch.frame[1 + ch.len];
+        uint8_t calculated_crc = crc8(ch.frame + 1, ch.len);
+        crc_ok = received_crc == calculated_crc;
+        if (!crc_ok) logger.logCRCError(calculated_crc, received_crc);
+    }
+
+    if (!crc_ok) {
+        rejectFrame(ch, rx_crc, ACK_CRC_ERROR);
+    } else if (!isImmediateCommand(ch.frame[1]) && (ch.hold || ch.entry < 0)) {
         logger.logError("QUEUE_FULL");
-        sendAck(ACK_PARAM_ERROR);
+        rejectFrame(ch, rx_crc, ACK_QUEUE_FULL);
+    } else {
+        processPacket(ch.frame + 1, ch.len, ch.entry);
+    }
+}
+
+// 收完的封包: 驗證 CRC, ACK, 放入佇列或立即執行
+void completeFrame(RxChannel &ch) {
+    rx_reply = &ch;
+    finishFrame(ch);
+    ch.state = (sink.total && sink.channel == &ch) ? 3 : 0;
+    ch.idx = 0;
+}
+
+// 丟棄接收中的封包, 釋放預留的佇列 entry (不送 ACK, Host 逾時後會重送)
+void dropPartialFrame(RxChannel &ch) {
+    if (ch.state == 2 && ch.entry >= 0) cmdQueue.discard(ch.entry);
+    ch.entry = -1;
+    ch.frame = nullptr;
+    ch.state = 0;
+    ch.idx = 0;
+    logger.logError("RX_TIMEOUT", "Partial frame dropped");
+}
+
+// 讀取一個埠的資料
+// defer: 由執行中的指令呼叫, 只把資料搬出硬體緩衝區, 收完一個封包就停, 交給 loop() 處理
+void serviceRx(RxChannel &ch, bool defer) {
+    if (ch.state == 4) {
+        if (defer) return;
+        completeFrame(ch);
+    }
+
+    if (ch.port->available() > 0) {
+        ch.last_byte_ms = millis();
+    } else if ((ch.state == 1 || ch.state == 2) && millis() - ch.last_byte_ms > ch.timeout_ms) {
+        dropPartialFrame(ch);
+    }
+
+    while (ch.port->available() > 0) {
+        uint8_t byte_in = ch.port->read();
+
+        switch(ch.state) {
+            case 0:    // 等待 SYNC
+                if (byte_in == SYNC_BYTE || byte_in == SYNC_BYTE_V2) {
+                    ch.crc16 = (byte_in == SYNC_BYTE_V2);
+                    ch.state = 1;
+                    ch.idx = 0;
+                }
+                break;
+
+            case 1: {  // 讀取 LEN, 並在佇列中預留空間
+                ch.len = byte_in;
+                uint8_t max_len = ch.crc16 ? MAX_PAYLOAD_V2 : MAX_PACKET_SIZE - 1;
+                if (ch.len == 0 || ch.len > max_len) {
+                    logger.logError("INVALID_LENGTH");
+                    rx_reply = &ch;
+                    sendAck(ACK_PARAM_ERROR);
+                    ch.state = 0;
+                    break;
+                }
+
+                logger.logPacketReceived(ch.len);
+                ch.entry = cmdQueue.reserve(ch.len, ch.crc16);
+                if (ch.entry >= 0) {
+                    ch.frame = cmdQueue.frame(ch.entry);
+                } else if (ch.len <= RX_SCRATCH_SIZE) {
+                    ch.frame = ch.scratch;
+                    ch.frame[0] = ch.len;
+                } else {
+                    ch.frame = nullptr;
+                }
+                ch.need = 1 + ch.len + (ch.crc16 ? 2 : 1);
+                ch.idx = 1;
+                ch.state = 2;
+                break;
+            }
+
+            case 2:    // 讀取資料 + CRC
+                if (ch.frame) ch.frame[ch.idx] = byte_in;
+                ch.crc_in = (ch.crc_in << 8) | byte_in;
+                ch.idx++;
+
+                if (ch.idx == ch.need) {
+                    if (defer) {
+                        ch.state = 4;
+                        return;
+                    }
+                    completeFrame(ch);
+                }
+                break;
+
+            case 3:    // SINK: 丟棄原始資料 (只在頭尾呼叫 micros())
+                if (sink.received == 0) sink.start_us = micros();
+                if (++sink.received == sink.total) {
+                    sink.end_us = micros();
+                    finishSink();
+                }
+                break;
+        }
+    }
+
+    if (ch.state == 3) {
+        serviceSinkTimeout();
+    }
+}
+
+// 執行耗時指令 (KB_PRINT 等) 期間定期呼叫
+// Serial1 硬體緩衝區只有 64 bytes, 1 Mbaud 下約 0.6 ms 就會溢位
+void pollRx() {
+    for (uint8_t i = 0; i < RX_CHANNEL_COUNT; i++) {
+        serviceRx(*RX_CHANNELS[i], true);
+    }
+}
+
+// 耗時指令每個 report 前呼叫; 回傳 true 表示被中斷, 按鍵已釋放, 應立即結束
+// (清空佇列與 ACK_INTERRUPTED 仍由 loop() 處理)
+bool pollAbort() {
+    pollRx();
+    if (!g_interrupt_flag) return false;
+    releaseAllInputs();
+    return true;
+}
+
+// ========== 按鈕動作 ==========
+// 巨集在 loop() 中直接執行, 不經過佇列: 不等待已排隊的 Host 指令, 佇列暫停或滿時也會執行
+// 計時動作 / 拖曳只有一組狀態, 已有進行中的任務時略過該步驟, 避免覆蓋後按鍵卡住
+#define MACRO_ENTRY_MAX       MAX_PACKET_SIZE
+
+void runMacro(uint8_t slot) {
+    if (slot >= MACRO_SLOT_COUNT) {
+        logger.logError("INVALID_MACRO_SLOT");
+        return;
+    }
+
+    logger.logCommand("RUN_MACRO");
+    const uint8_t *p = MACRO_SLOTS[slot];
+    uint8_t entry[MACRO_ENTRY_MAX];
+    uint8_t len;
+    while ((len = pgm_read_byte(p++)) != 0) {
+        if (len > MACRO_ENTRY_MAX) {
+            logger.logError("MACRO_ENTRY_TOO_LONG", "Macro truncated");
+            return;
+        }
+        memcpy_P(entry, p, len);
+        p += len;
+
+        bool starts_task = entry[0] == CMD_MOUSE_PRESS_TIMED || entry[0] == CMD_KB_PRESS_TIMED ||
+                           entry[0] == CMD_MOUSE_DRAG;
+        if (starts_task && (timedAction.active || dragTask.active)) {
+            logger.logError("MACRO_BUSY", "Task step skipped");
+            continue;
+        }
+        executeCommand(entry[0], entry + 1, len - 1);
+    }
+}
+
+void dispatchButtonActions() {
+    // 暫停狀態由 ISR 切換, 這裡只負責通知
+    static bool last_paused = false;
+    bool paused = g_queue_paused;
+    if (paused != last_paused) {
+        last_paused = paused;
+        logger.logQueuePauseChange(paused);
+        sendEvent(EVT_QUEUE_PAUSED, paused ? 1 : 0);
+    }
+
+    if (g_button_pending == 0) return;
+
+    noInterrupts();
+    uint8_t pending = g_button_pending;
+    g_button_pending = 0;
+    interrupts();
+
+    for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+        if (!(pending & (1 << i))) continue;
+        const ButtonBinding& binding = BUTTON_BINDINGS[i];
+        switch (binding.action) {
+            case BTN_ACTION_RUN_MACRO:
+                runMacro(binding.arg);
+                break;
+            case BTN_ACTION_EMIT_EVENT:
+                sendEvent(EVT_BUTTON, binding.arg);
+                break;
+        }
     }
 }
 
@@ -618,15 +1615,23 @@ void setup() {
     Serial.begin(115200);
     while (!Serial && millis() < 3000);
 
+#if SERIAL1_MODE == SERIAL1_MODE_COMMAND
+    // Serial1: 第二個指令輸入埠
+    Serial1.begin(SERIAL1_CMD_BAUD);
+#else
     // Serial1: 監控日誌輸出
-    logger.begin(115200);
+    logger.begin(SERIAL1_LOG_BAUD);
+#endif
 
     Keyboard.begin();
     Mouse.begin();
 
-    // 設定中斷按鈕
-    pinMode(INTERRUPT_PIN, INPUT_PULLUP);
-    attachInterrupt(digitalPinToInterrupt(INTERRUPT_PIN), buttonISR, FALLING);
+    // 設定按鈕綁定
+    for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+        const ButtonBinding& binding = BUTTON_BINDINGS[i];
+        pinMode(binding.pin, INPUT_PULLUP);
+        attachInterrupt(digitalPinToInterrupt(binding.pin), BUTTON_ISRS[i], binding.edge);
+    }
 
     // 清空接收緩衝區
     while (Serial.available()) {
@@ -639,31 +1644,25 @@ void setup() {
 void loop() {
     // === 1. 處理硬體中斷 ===
     if (g_interrupt_flag) {
-        logger.logInterrupt();
-        
+        // 先釋放所有按鍵/按鈕, 日誌之後再寫
+        releaseAllInputs();
+
         // 清空佇列
         cmdQueue.clear();
-        
-        // 釋放所有按鍵/按鈕
-        Keyboard.releaseAll();
-        Mouse.release(MOUSE_LEFT | MOUSE_RIGHT | MOUSE_MIDDLE);
-        
-        // 清除計時動作
-        if (timedAction.active) {
-            if (timedAction.action_type == 0) {
-                Mouse.release(timedAction.button_or_key);
-            } else {
-                Keyboard.release(timedAction.button_or_key);
-            }
-            timedAction.active = false;
-        }
-        
-        // 通知 Host
-        sendAck(ACK_INTERRUPTED);
-        
-        g_interrupt_flag = false;
+
+        // 通知所有 Host
+        broadcastAck(ACK_INTERRUPTED);
+
+        // 釋放之後若又按下, ISR 已清除 g_abort_released: 保留旗標, 下一輪再釋放一次
+        noInterrupts();
+        if (g_abort_released) g_interrupt_flag = false;
+        interrupts();
+        logger.logInterrupt();
     }
 
+    // === 1.5 處理按鈕動作 (巨集 / 事件) ===
+    dispatchButtonActions();
+
     // === 2. 處理計時動作 (非阻塞) ===
     if (timedAction.active) {
         if (millis() - timedAction.start_time >= timedAction.duration_ms) {
@@ -678,57 +1677,23 @@ void loop() {
         }
     }
 
-    // === 3. 接收新封包 ===
-    while (Serial.available() > 0) {
-        uint8_t byte_in = Serial.read();
-
-        switch(rx_state) {
-            case 0:    // 等待 SYNC
-                if (byte_in == SYNC_BYTE) {
-                    rx_state = 1;
-                    rx_idx = 0;
-                }
-                break;
-
-            case 1:    // 讀取 LEN
-                rx_len = byte_in;
-                if (rx_len == 0 || rx_len > MAX_PACKET_SIZE - 1) {
-                    logger.logError("INVALID_LENGTH");
-                    sendAck(ACK_PARAM_ERROR);
-                    rx_state = 0;
-                } else {
-                    logger.logPacketReceived(rx_len);
-                    rx_state = 2;
-                    rx_idx = 0;
-                }
-                break;
-
-            case 2:    // 讀取資料 + CRC
-                rx_buffer[rx_idx++] = byte_in;
-
-                if (rx_idx == rx_len + 1) {
-                    uint8_t received_crc = rx_buffer[rx_len];
-                    uint8_t calculated_crc = crc8(rx_buffer, rx_len);
-
-                    if (received_crc == calculated_crc) {
-                        processPacket(rx_buffer, rx_len);
-                    } else {
-                        logger.logCRCError(calculated_crc, received_crc);
-                        sendAck(ACK_CRC_ERROR);
-                    }
+    // === 2.5 處理拖曳 (非阻塞) ===
+    if (dragTask.active) {
+        serviceDrag();
+    }
 
-                    rx_state = 0;
-                    rx_idx = 0;
-                }
-                break;
-        }
+    // === 3. 接收新封包 ===
+    for (uint8_t i = 0; i < RX_CHANNEL_COUNT; i++) {
+        serviceRx(*RX_CHANNELS[i], false);
     }
 
     // === 4. 執行佇列中的指令 ===
-    if (!timedAction.active && !cmdQueue.isEmpty()) {
-        CommandPacket packet;
-        if (cmdQueue.pop(packet)) {
-            executeCommand(packet);
+    if (!timedAction.active && !dragTask.active && !g_queue_paused) {
+        const uint8_t *data;
+        uint8_t len;
+        if (cmdQueue.peek(data, len)) {
+            executeCommand(data[0], data + 1, len - 1);
+            cmdQueue.pop();
         }
     }
 
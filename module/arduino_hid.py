@@ -2,8 +2,11 @@ import serial
 import serial.tools.list_ports
 import struct
 import time
+from collections import deque
 from typing import Optional, List, Tuple
-from module.com_port_detector import PortDetector as pd
+from module.com.port_detector import PortDetector as pd
+from module import hid_frame, hid_text
+from module.logger import logger
 
 class ArduinoHIDException(Exception):
     """Arduino HID 異常"""
@@ -12,12 +15,44 @@ class ArduinoHIDException(Exception):
 
 class ArduinoHID:
     # Protocol
+    # V1: [0xAA][LEN 1~31][DATA][CRC-8]
+    # V2: [0xAB][LEN 1~255][DATA][CRC-16 H][CRC-16 L], CRC 涵蓋 LEN + DATA
     SYNC_BYTE = 0xAA
+    SYNC_BYTE_V2 = 0xAB
+    MAX_PAYLOAD_V1 = 31
+    MAX_PAYLOAD_V2 = 255
+    FEATURE_FRAME_V2 = 0x01
+    FEATURE_LOOPBACK = 0x02  # CMD_ECHO / CMD_SINK
+    FEATURE_MEMINFO = 0x04  # CMD_GET_MEMINFO
+    FEATURE_KB_USAGES = 0x08  # CMD_KB_USAGES
+    FEATURE_KB_PRINT_Z = 0x10  # CMD_KB_PRINT_Z
+    FEATURE_SERIAL1_CMD = 0x20  # 韌體以 SERIAL1_MODE_COMMAND 編譯, Serial1 (UART) 也接受指令
+    FEATURE_ABORT_STATS = 0x40  # CMD_GET_ABORT_STATS
+    FEATURE_MOUSE_DRAG = 0x80  # CMD_MOUSE_DRAG
+
+    # send_batch: 單次 write() 的上限; 每批的封包總大小也不超過 Arduino 佇列池
+    # (佇列 entry = [STATE][LEN][DATA][CRC], 與封包大小相同)
+    BATCH_CAPACITY = 4096
+    QUEUE_POOL_SIZE = 640  # 韌體預設值, 協商時以 GET_CAPS 回報的大小取代
     ACK_SUCCESS = 0xF0
     ACK_CRC_ERROR = 0xF1
     ACK_INVALID_CMD = 0xF2
     ACK_PARAM_ERROR = 0xF3
     ACK_INTERRUPTED = 0xF4  # 新增:被中斷
+    ACK_QUEUE_FULL = 0xF7  # 佇列已滿, 稍後重送
+
+    # 佇列滿時的重送間隔與放棄時間 (秒)
+    QUEUE_FULL_BACKOFF = 0.002
+    QUEUE_FULL_TIMEOUT = 1.0
+
+    # Event (Device → Host, 非請求): [EVT_MARKER][EVT][ARG]
+    EVT_MARKER = 0xF5
+    EVT_BUTTON = 0x01  # ARG = 按鈕綁定設定的值
+    EVT_QUEUE_PAUSED = 0x02  # ARG = 1 暫停 / 0 恢復
+
+    # Response (Device → Host, 緊接在查詢指令的 ACK 之後)
+    # [RESP_MARKER][LEN][DATA][CRC-16 H][CRC-16 L], CRC 涵蓋 LEN + DATA
+    RESP_MARKER = 0xF6
 
     # Command
     CMD_MOUSE_MOVE = 0x01
@@ -25,15 +60,43 @@ class ArduinoHID:
     CMD_MOUSE_RELEASE = 0x03
     CMD_MOUSE_CLICK = 0x04
     CMD_MOUSE_PRESS_TIMED = 0x05
+    CMD_MOUSE_DRAG = 0x06  # 按下 → 依時間移動 → 放開, Arduino 端非阻塞執行
     CMD_KB_PRESS = 0x10
     CMD_KB_RELEASE = 0x11
     CMD_KB_WRITE = 0x12
     CMD_KB_RELEASE_ALL = 0x13
     CMD_KB_PRINT = 0x14
     CMD_KB_PRESS_TIMED = 0x15
+    CMD_KB_USAGES = 0x16  # N x [MOD][USAGE], 由 module.hid_text 編譯
+    CMD_KB_PRINT_Z = 0x17  # [FLAGS][TOKENS], RLE + LZ 壓縮的 KB_PRINT (見 compress_text)
     CMD_PAUSE_LOG = 0x20  # 新增:暫停日誌
     CMD_RESUME_LOG = 0x21  # 新增:恢復日誌
     CMD_CLEAR_QUEUE = 0x22  # 新增:清空佇列
+    CMD_GET_CAPS = 0x23  # 查詢協議能力 (有回應封包)
+    CMD_ECHO = 0x24  # 原封不動回傳 PARAMS (有回應封包)
+    CMD_SINK = 0x25  # 接著接收 N bytes 原始資料並丟棄, 完成後回報耗時
+    CMD_GET_MEMINFO = 0x26  # 查詢 SRAM 使用量 (有回應封包)
+    CMD_GET_ABORT_STATS = 0x27  # 查詢中斷按鈕到釋放按鍵的延遲 (有回應封包)
+
+    # CMD_GET_MEMINFO 回應中的靜態結構編號
+    MEM_IDS = {
+        0x01: 'queue',
+        0x02: 'rx_channels',
+        0x03: 'logger',
+        0x04: 'timed_action',
+        0x05: 'buttons',
+        0x06: 'sink',
+        0x07: 'serial1',
+        0x08: 'z_window',
+    }
+
+    # CMD_KB_PRINT_Z 壓縮格式 (韌體保留最近 Z_WINDOW 個輸出字元)
+    # 0LLLLLLL [L+1 字元] / 10LLLLLL [CHAR] 重複 L+3 次 / 11LLLLLL [DIST-1] 複製 L+3 個
+    Z_FLAG_RESET = 0x01
+    Z_WINDOW = 128
+    Z_MIN_MATCH = 3
+    Z_MAX_MATCH = 66
+    Z_MAX_LITERAL = 128
 
     # Mouse
     MOUSE_LEFT = 0x01
@@ -78,101 +141,144 @@ class ArduinoHID:
     KEY_F11 = 0xCC
     KEY_F12 = 0xCD
 
-    # CRC-8/MAXIM lookup table
-    CRC8_TABLE = [
-        0x00, 0x5E, 0xBC, 0xE2, 0x61, 0x3F, 0xDD, 0x83,
-        0xC2, 0x9C, 0x7E, 0x20, 0xA3, 0xFD, 0x1F, 0x41,
-        0x9D, 0xC3, 0x21, 0x7F, 0xFC, 0xA2, 0x40, 0x1E,
-        0x5F, 0x01, 0xE3, 0xBD, 0x3E, 0x60, 0x82, 0xDC,
-        0x23, 0x7D, 0x9F, 0xC1, 0x42, 0x1C, 0xFE, 0xA0,
-        0xE1, 0xBF, 0x5D, 0x03, 0x80, 0xDE, 0x3C, 0x62,
-        0xBE, 0xE0, 0x02, 0x5C, 0xDF, 0x81, 0x63, 0x3D,
-        0x7C, 0x22, 0xC0, 0x9E, 0x1D, 0x43, 0xA1, 0xFF,
-        0x46, 0x18, 0xFA, 0xA4, 0x27, 0x79, 0x9B, 0xC5,
-        0x84, 0xDA, 0x38, 0x66, 0xE5, 0xBB, 0x59, 0x07,
-        0xDB, 0x85, 0x67, 0x39, 0xBA, 0xE4, 0x06, 0x58,
-        0x19, 0x47, 0xA5, 0xFB, 0x78, 0x26, 0xC4, 0x9A,
-        0x65, 0x3B, 0xD9, 0x87, 0x04, 0x5A, 0xB8, 0xE6,
-        0xA7, 0xF9, 0x1B, 0x45, 0xC6, 0x98, 0x7A, 0x24,
-        0xF8, 0xA6, 0x44, 0x1A, 0x99, 0xC7, 0x25, 0x7B,
-        0x3A, 0x64, 0x86, 0xD8, 0x5B, 0x05, 0xE7, 0xB9,
-        0x8C, 0xD2, 0x30, 0x6E, 0xED, 0xB3, 0x51, 0x0F,
-        0x4E, 0x10, 0xF2, 0xAC, 0x2F, 0x71, 0x93, 0xCD,
-        0x11, 0x4F, 0xAD, 0xF3, 0x70, 0x2E, 0xCC, 0x92,
-        0xD3, 0x8D, 0x6F, 0x31, 0xB2, 0xEC, 0x0E, 0x50,
-        0xAF, 0xF1, 0x13, 0x4D, 0xCE, 0x90, 0x72, 0x2C,
-        0x6D, 0x33, 0xD1, 0x8F, 0x0C, 0x52, 0xB0, 0xEE,
-        0x32, 0x6C, 0x8E, 0xD0, 0x53, 0x0D, 0xEF, 0xB1,
-        0xF0, 0xAE, 0x4C, 0x12, 0x91, 0xCF, 0x2D, 0x73,
-        0xCA, 0x94, 0x76, 0x28, 0xAB, 0xF5, 0x17, 0x49,
-        0x08, 0x56, 0xB4, 0xEA, 0x69, 0x37, 0xD5, 0x8B,
-        0x57, 0x09, 0xEB, 0xB5, 0x36, 0x68, 0x8A, 0xD4,
-        0x95, 0xCB, 0x29, 0x77, 0xF4, 0xAA, 0x48, 0x16,
-        0xE9, 0xB7, 0x55, 0x0B, 0x88, 0xD6, 0x34, 0x6A,
-        0x2B, 0x75, 0x97, 0xC9, 0x4A, 0x14, 0xF6, 0xA8,
-        0x74, 0x2A, 0xC8, 0x96, 0x15, 0x4B, 0xA9, 0xF7,
-        0xB6, 0xE8, 0x0A, 0x54, 0xD7, 0x89, 0x6B, 0x35
-    ]
+    # CRC lookup tables (見 module/hid_frame.py)
+    CRC8_TABLE = hid_frame.CRC8_TABLE
+    CRC16_TABLE = hid_frame.CRC16_TABLE
 
     def __init__(self, port: Optional[str] = None, baudrate: int = 115200,
-                 timeout: float = 0.1, retries: int = 3, debug=False, auto_detect: bool = True):
+                 timeout: float = 0.1, retries: int = 3, debug=False, auto_detect: bool = True,
+                 negotiate: bool = True, ser=None, trace: Optional[str] = None):
         """
         初始化 Arduino HID (改良版)
 
         Args:
-            port: COM port (None 則自動偵測)
+            port: COM port (None 則自動偵測); 也可以是接到 Arduino Serial1 的 UART
+                  (韌體需以 SERIAL1_MODE_COMMAND 編譯, 例如 port='/dev/ttyAMA0', baudrate=1000000)
             baudrate: 傳輸速率
             timeout: 逾時時間
             retries: 重試次數
             auto_detect: 是否自動偵測
+            negotiate: 是否與韌體協商 V2 大封包格式 (舊韌體自動退回 V1)
+            ser: 已開啟的 serial 物件 (例如 module.hid_emulator.EmulatedSerial), 指定時忽略 port
+            trace: 追蹤檔路徑, 記錄所有收發的位元組 (見 module.hid_trace)
         """
         self.interrupted = False  # 中斷旗標
+        self.queue_paused = False  # Arduino 端佇列是否被按鈕暫停
+        self.events = deque(maxlen=64)  # 收到的事件 (evt, arg)
+        self.frame_v2 = False  # 是否使用 V2 封包 (CRC-16)
+        self.max_payload = self.MAX_PAYLOAD_V1  # 單一封包 DATA 上限 (CMD + PARAMS)
+        self.features = 0  # 協商時取得的韌體能力 (FEATURE_*)
+        self.queue_pool_size = self.QUEUE_POOL_SIZE
+        self.keyboard_layout = 'us'  # 目標電腦的鍵盤配置 (見 module.hid_text.LAYOUTS)
+        self._batch = None  # send_batch 共用的封包緩衝區
+        self.stats = {'packets': 0, 'retries': 0, 'timeouts': 0, 'crc_errors': 0, 'queue_full': 0}
+        self.retries = retries
+
+        if ser is not None:
+            self.ser = ser
+        else:
+            if port is None and auto_detect:
+                port = pd.find_arduino()
+
+            if port is None:
+                # 這裡可以加入你的 PortDetector
+                available_ports = list(serial.tools.list_ports.comports())
+                if available_ports:
+                    port = available_ports[0].device
+                    print(f"🔍 自動選擇: {port}")
+                else:
+                    raise ArduinoHIDException("找不到可用的 COM Port")
 
-        port = pd.find_arduino()
+            try:
+                self.ser = serial.Serial(port, baudrate, timeout=timeout)
+                print(f"✓ 已連接到: {port} @ {baudrate} bps")
+                time.sleep(2)  # 等待 Arduino 初始化
 
-        if port is None:
-            # 這裡可以加入你的 PortDetector
-            available_ports = list(serial.tools.list_ports.comports())
-            if available_ports:
-                port = available_ports[0].device
-                print(f"🔍 自動選擇: {port}")
-            else:
-                raise ArduinoHIDException("找不到可用的 COM Port")
+                # 清空接收緩衝區
+                self.ser.reset_input_buffer()
+                self.ser.reset_output_buffer()
 
-        try:
-            self.ser = serial.Serial(port, baudrate, timeout=timeout)
-            self.retries = retries
-            print(f"✓ 已連接到: {port} @ {baudrate} bps")
-            time.sleep(2)  # 等待 Arduino 初始化
+            except serial.SerialException as e:
+                raise ArduinoHIDException(f"無法開啟 {port}: {e}")
 
-            # 清空接收緩衝區
-            self.ser.reset_input_buffer()
-            self.ser.reset_output_buffer()
+        if trace is not None:
+            from module.hid_trace import TracingSerial  # hid_trace 經由 module.bench 匯入本模組, 延後載入
+            self.ser = TracingSerial(self.ser, trace)
 
-        except serial.SerialException as e:
-            raise ArduinoHIDException(f"無法開啟 {port}: {e}")
+        if negotiate:
+            self.negotiate_frame_format()
 
     def _crc8(self, data: bytes) -> int:
         """計算 CRC-8/MAXIM"""
-        crc = 0x00
-        for byte in data:
-            crc = self.CRC8_TABLE[crc ^ byte]
-        return crc
+        return hid_frame.crc8(data)
+
+    def _crc16(self, data: bytes, crc: int = 0xFFFF) -> int:
+        """計算 CRC-16/CCITT"""
+        return hid_frame.crc16(data, crc)
+
+    def _build_packet(self, data: bytes) -> bytes:
+        """依協商結果組成 V1 或 V2 封包"""
+        return hid_frame.build_frame(data, self.frame_v2)
+
+    def _handle_event(self, evt: int, arg: int):
+        """記錄事件封包"""
+        if evt == self.EVT_QUEUE_PAUSED:
+            self.queue_paused = bool(arg)
+        self.events.append((evt, arg))
+
+    def _read_ack(self) -> bytes:
+        """讀取 ACK, 途中收到的事件封包會被記錄並略過"""
+        while True:
+            ack = self.ser.read(1)
+            if len(ack) == 0 or ack[0] != self.EVT_MARKER:
+                return ack
+            body = self.ser.read(2)
+            if len(body) == 2:
+                self._handle_event(body[0], body[1])
+
+    def poll_events(self) -> List[Tuple[int, int]]:
+        """
+        讀取閒置時收到的事件 (不送出任何指令)
+
+        Returns:
+            List[(evt, arg)]: 自上次呼叫以來的所有事件
+        """
+        while self.ser.in_waiting:
+            code = self.ser.read(1)
+            if len(code) == 0:
+                break
+            if code[0] == self.EVT_MARKER:
+                body = self.ser.read(2)
+                if len(body) == 2:
+                    self._handle_event(body[0], body[1])
+            elif code[0] == self.ACK_INTERRUPTED:
+                self.interrupted = True
+
+        events = list(self.events)
+        self.events.clear()
+        return events
 
     def _send_packet(self, cmd: int, params: bytes = b'') -> bool:
         """發送封包並等待 ACK"""
         data = bytes([cmd]) + params
-        data_len = len(data)
-        crc = self._crc8(data)
-        packet = bytes([self.SYNC_BYTE, data_len]) + data + bytes([crc])
-
-        for attempt in range(self.retries):
+        if len(data) > self.max_payload:
+            raise ArduinoHIDException(f"Packet too long: {len(data)} > {self.max_payload} bytes")
+        packet = self._build_packet(data)
+        self.stats['packets'] += 1
+
+        attempt = 0
+        queue_full_deadline = None
+        while attempt < self.retries:
+            if attempt > 0 or queue_full_deadline is not None:
+                self.stats['retries'] += 1
             try:
                 self.ser.write(packet)
-                ack = self.ser.read(1)
+                ack = self._read_ack()
 
                 if len(ack) == 0:
-                    if attempt < self.retries - 1:
+                    self.stats['timeouts'] += 1
+                    attempt += 1
+                    if attempt < self.retries:
                         time.sleep(0.01)
                         continue
                     raise ArduinoHIDException("No ACK received")
@@ -181,11 +287,23 @@ class ArduinoHID:
 
                 if ack_code == self.ACK_SUCCESS:
                     return True
+                elif ack_code == self.ACK_QUEUE_FULL:
+                    # 佇列滿不算失敗, 等 Arduino 消化後重送 (不消耗重試次數)
+                    self.stats['queue_full'] += 1
+                    now = time.perf_counter()
+                    if queue_full_deadline is None:
+                        queue_full_deadline = now + self.QUEUE_FULL_TIMEOUT
+                    if now < queue_full_deadline:
+                        time.sleep(self.QUEUE_FULL_BACKOFF)
+                        continue
+                    raise ArduinoHIDException("Queue full")
                 elif ack_code == self.ACK_INTERRUPTED:
                     self.interrupted = True
                     raise ArduinoHIDException("⚠️ 指令被硬體按鈕中斷!")
                 elif ack_code == self.ACK_CRC_ERROR:
-                    if attempt < self.retries - 1:
+                    self.stats['crc_errors'] += 1
+                    attempt += 1
+                    if attempt < self.retries:
                         time.sleep(0.01)
                         continue
                     raise ArduinoHIDException("CRC error")
@@ -201,8 +319,281 @@ class ArduinoHID:
 
         return False
 
+    def _batch_chunks(self, commands: List[Tuple[int, bytes]]):
+        """依封包大小累計切批, 每批不超過緩衝區與 Arduino 佇列池"""
+        limit = min(self.BATCH_CAPACITY, self.queue_pool_size)
+        chunk, used = [], 0
+        for command in commands:
+            size = hid_frame.frame_size(1 + len(command[1]), self.frame_v2)
+            if chunk and used + size > limit:
+                yield chunk
+                chunk, used = [], 0
+            chunk.append(command)
+            used += size
+        if chunk:
+            yield chunk
+
+    def send_batch(self, commands: List[Tuple[int, bytes]]) -> List[int]:
+        """
+        將多個指令組成一次 write() 送出, 再依序讀取 ACK
+
+        某個封包遇到 CRC 錯誤或佇列滿時, 仍讀完該批其餘的 ACK, 再從該封包起
+        依原順序重送之後所有未成功的指令, 之後的批次等重送完才送出。
+        韌體拒收一個封包後, 同一埠之後的封包也一律拒收到它重送為止 (QUEUE_HOLD_MS),
+        所以較小的後續封包不會先進佇列, 執行順序與 commands 相同。
+
+        Args:
+            commands: [(cmd, params), ...]
+
+        Returns:
+            List[int]: 每個指令的 ACK 代碼
+        """
+        if self._batch is None or self._batch.v2 != self.frame_v2:
+            self._batch = hid_frame.FrameBuilder(v2=self.frame_v2, capacity=self.BATCH_CAPACITY)
+
+        acks = [self.ACK_SUCCESS] * len(commands)
+        self.stats['packets'] += len(commands)
+        pending = list(range(len(commands)))  # 尚未送出或需要重送的指令 (原順序)
+        crc_attempts = 0
+        queue_full_deadline = None
+        while pending:
+            if queue_full_deadline is None:
+                chunk = next(self._batch_chunks([commands[i] for i in pending]))
+            else:
+                chunk = [commands[pending[0]]]  # 佇列滿時只重送第一個, 成功後再恢復整批
+            sent, pending = pending[:len(chunk)], pending[len(chunk):]
+            self._batch.clear()
+            self._batch.extend(chunk)
+            try:
+                self.ser.write(self._batch.getbuffer())
+            except serial.SerialException as e:
+                raise ArduinoHIDException(f"Serial error: {e}")
+
+            # 讀完這批的 ACK 才重送, 否則重送的 ACK 會和後面的 ACK 交錯
+            chunk_acks = []
+            interrupted = False
+            while len(chunk_acks) < len(sent):
+                ack = self._read_ack()
+                if len(ack) == 0:
+                    if interrupted:
+                        break
+                    raise ArduinoHIDException("No ACK received")
+                if ack[0] == self.ACK_INTERRUPTED:
+                    # 中斷 ACK 不屬於任何封包, 讀完其餘 ACK 再拋出, 避免之後的 ACK 錯位
+                    interrupted = True
+                    continue
+                chunk_acks.append(ack[0])
+            if interrupted:
+                self.interrupted = True
+                raise ArduinoHIDException("⚠️ 指令被硬體按鈕中斷!")
+
+            resend = []
+            for idx, ack_code in zip(sent, chunk_acks):
+                acks[idx] = ack_code
+                if ack_code == self.ACK_CRC_ERROR:
+                    self.stats['crc_errors'] += 1
+                    resend.append(idx)
+                elif ack_code == self.ACK_QUEUE_FULL:
+                    self.stats['queue_full'] += 1
+                    resend.append(idx)
+            if len(resend) < len(sent):
+                queue_full_deadline = None  # 有進展才重新計時
+            if not resend:
+                continue
+
+            # 已成功的不重送, 被拒收的依原順序排在剩下的指令前面
+            pending = resend + pending
+            self.stats['retries'] += len(resend)
+            if any(acks[idx] == self.ACK_QUEUE_FULL for idx in resend):
+                # 佇列滿不消耗重試次數, 等 Arduino 消化後重送
+                now = time.perf_counter()
+                if queue_full_deadline is None:
+                    queue_full_deadline = now + self.QUEUE_FULL_TIMEOUT
+                if now >= queue_full_deadline:
+                    raise ArduinoHIDException("Queue full")
+                time.sleep(self.QUEUE_FULL_BACKOFF)
+            else:
+                crc_attempts += 1
+                if crc_attempts >= self.retries:
+                    raise ArduinoHIDException("CRC error")
+                time.sleep(0.01)
+        return acks
+
+    def _read_response(self) -> Optional[bytes]:
+        """讀取回應封包, 逾時或 CRC 錯誤回傳 None"""
+        marker = self._read_ack()
+        if len(marker) == 0 or marker[0] != self.RESP_MARKER:
+            return None
+        length = self.ser.read(1)
+        if len(length) == 0:
+            return None
+        body = self.ser.read(length[0] + 2)
+        if len(body) != length[0] + 2:
+            return None
+        data, crc = body[:-2], int.from_bytes(body[-2:], 'big')
+        if self._crc16(length + data) != crc:
+            return None
+        return data
+
+    def _query(self, cmd: int, params: bytes = b'') -> Optional[bytes]:
+        """發送查詢指令並讀取回應封包"""
+        if not self._send_packet(cmd, params):
+            return None
+        return self._read_response()
+
+    # ========== 鏈路自我測試 ==========
+
+    def echo(self, payload: bytes = b'') -> Optional[bytes]:
+        """
+        送出 payload 並等待原封不動的回傳 (用來量測來回延遲)
+
+        Returns:
+            回傳的 payload, 逾時或 CRC 錯誤回傳 None
+        """
+        return self._query(self.CMD_ECHO, payload)
+
+    def sink(self, total_bytes: int, chunk_size: int = 4096, timeout: float = 5.0) -> Optional[dict]:
+        """
+        送出 total_bytes 原始資料給 Arduino 丟棄, 量測 USB CDC 本身的頻寬
+
+        Args:
+            total_bytes: 傳送的資料量
+            chunk_size: 每次 write() 的大小
+            timeout: 等待結果的逾時時間 (秒)
+
+        Returns:
+            dict: received, device_us (Arduino 端首尾 byte 的間隔), host_s (Host 端寫入 + 等待結果)
+            None: 韌體不支援或逾時
+        """
+        if not self._send_packet(self.CMD_SINK, struct.pack('>I', total_bytes)):
+            return None
+
+        chunk = bytes(chunk_size)
+        start = time.perf_counter()
+        remaining = total_bytes
+        try:
+            while remaining > 0:
+                n = min(remaining, chunk_size)
+                self.ser.write(chunk[:n])
+                remaining -= n
+            self.ser.flush()
+        except serial.SerialException as e:
+            raise ArduinoHIDException(f"Serial error: {e}")
+
+        old_timeout = self.ser.timeout
+        self.ser.timeout = timeout
+        try:
+            resp = self._read_response()
+        finally:
+            self.ser.timeout = old_timeout
+        host_s = time.perf_counter() - start
+
+        if resp is None or len(resp) != 8:
+            return None
+        received, device_us = struct.unpack('>II', resp)
+        return {'received': received, 'device_us': device_us, 'host_s': host_s}
+
     # ========== 新增的控制方法 ==========
 
+    def get_capabilities(self) -> Optional[dict]:
+        """
+        查詢韌體的協議能力
+
+        Returns:
+            dict / None (舊韌體不回應)
+        """
+        resp = self._query(self.CMD_GET_CAPS)
+        if resp is None or len(resp) < 5:
+            return None
+        return {
+            'version': resp[0],
+            'features': resp[1],
+            'max_payload': resp[2],
+            'queue_pool_size': (resp[3] << 8) | resp[4],
+        }
+
+    def get_meminfo(self) -> Optional[dict]:
+        """
+        查詢 Arduino 的 SRAM 使用量 (bytes)
+
+        Returns:
+            dict / None (舊韌體不回應):
+                ram: SRAM 總量
+                static: .data + .bss
+                free: 目前 heap 與 stack 之間的空間
+                free_min: 開機以來最少的剩餘空間 (stack high-water)
+                stack_max: stack 曾使用的最大深度
+                structures: {名稱: 大小}
+        """
+        resp = self._query(self.CMD_GET_MEMINFO)
+        if resp is None or len(resp) < 11:
+            return None
+        ram, static, free, free_min, stack_max, count = struct.unpack('>HHHHHB', resp[:11])
+        structures = {}
+        for i in range(count):
+            offset = 11 + i * 3
+            if offset + 3 > len(resp):
+                break
+            mem_id, size = struct.unpack('>BH', resp[offset:offset + 3])
+            structures[self.MEM_IDS.get(mem_id, f'0x{mem_id:02X}')] = size
+        return {
+            'ram': ram,
+            'static': static,
+            'free': free,
+            'free_min': free_min,
+            'stack_max': stack_max,
+            'structures': structures,
+        }
+
+    def get_abort_stats(self) -> Optional[dict]:
+        """
+        查詢中斷按鈕的反應時間 (ISR 觸發到所有按鍵 / 按鈕釋放完成)
+
+        Returns:
+            dict / None (舊韌體不回應):
+                count: 開機以來的中斷次數
+                over_bound: 超過 bound_us 的次數
+                last_us / max_us: 最近一次 / 最長的延遲 (微秒)
+                bound_us: 韌體設定的目標上限 (ABORT_BOUND_US)
+        """
+        resp = self._query(self.CMD_GET_ABORT_STATS)
+        if resp is None or len(resp) < 16:
+            return None
+        count, over_bound, last_us, max_us, bound_us = struct.unpack('>HHIII', resp[:16])
+        return {
+            'count': count,
+            'over_bound': over_bound,
+            'last_us': last_us,
+            'max_us': max_us,
+            'bound_us': bound_us,
+        }
+
+    def negotiate_frame_format(self) -> bool:
+        """
+        協商封包格式, 韌體支援時切換到 V2 (最多 255 bytes, CRC-16)
+
+        Returns:
+            True: 使用 V2, False: 維持 V1
+        """
+        caps = self.get_capabilities()
+        self.features = caps['features'] if caps else 0
+        if caps and caps['queue_pool_size']:
+            self.queue_pool_size = caps['queue_pool_size']
+        if caps is None or not (caps['features'] & self.FEATURE_FRAME_V2):
+            self.frame_v2 = False
+            self.max_payload = self.MAX_PAYLOAD_V1
+            return False
+
+        self.frame_v2 = True
+        self.max_payload = min(caps['max_payload'], self.MAX_PAYLOAD_V2)
+        print(f"✓ 使用 V2 封包格式 (最大 {self.max_payload} bytes, 佇列 {caps['queue_pool_size']} bytes)")
+        return True
+
+    def reset_stats(self):
+        """重置傳輸統計 (packets / retries / timeouts / crc_errors / queue_full)"""
+        for key in self.stats:
+            self.stats[key] = 0
+
     def pause_logging(self) -> bool:
         """暫停 Arduino 端的日誌輸出"""
         return self._send_packet(self.CMD_PAUSE_LOG)
@@ -251,6 +642,46 @@ class ArduinoHID:
         params = struct.pack('>BH', button, duration_ms)
         return self._send_packet(self.CMD_MOUSE_PRESS_TIMED, params)
 
+    def mouse_drag(self, dx: int, dy: int, button: int = MOUSE_LEFT, duration_ms: int = 200,
+                   press_settle_ms: int = 30, release_settle_ms: int = 30) -> bool:
+        """
+        拖曳: 按下 → 等待 → 在 duration_ms 內平均移動 (dx, dy) → 等待 → 放開
+
+        整段在 Arduino 端以單一指令執行 (時間不受 Host 影響, Host 中途當掉也會放開),
+        執行期間後續指令在佇列中等待。韌體不支援時退回 press / move / release。
+
+        Args:
+            dx, dy: 總位移 (HID counts, 換算像素見 module.pointer_calibration)
+            button: 滑鼠按鍵
+            duration_ms: 移動時間
+            press_settle_ms: 按下後開始移動前的等待
+            release_settle_ms: 移動完成後放開前的等待
+        """
+        dx = max(-32767, min(32767, dx))
+        dy = max(-32767, min(32767, dy))
+        duration_ms, press_settle_ms, release_settle_ms = (
+            max(0, min(65535, ms)) for ms in (duration_ms, press_settle_ms, release_settle_ms))
+        if self.features & self.FEATURE_MOUSE_DRAG:
+            params = struct.pack('>BhhHHH', button, dx, dy, duration_ms, press_settle_ms, release_settle_ms)
+            return self._send_packet(self.CMD_MOUSE_DRAG, params)
+
+        if not self.mouse_press(button):
+            return False
+        try:
+            time.sleep(press_settle_ms / 1000)
+            steps = max(1, -(-max(abs(dx), abs(dy)) // 127), duration_ms // 10)
+            sent_x = sent_y = 0
+            for i in range(1, steps + 1):
+                step_x, step_y = dx * i // steps - sent_x, dy * i // steps - sent_y
+                if (step_x or step_y) and not self.mouse_move(step_x, step_y):
+                    return False
+                sent_x, sent_y = sent_x + step_x, sent_y + step_y
+                time.sleep(duration_ms / 1000 / steps)
+            time.sleep(release_settle_ms / 1000)
+        finally:
+            self.mouse_release(button)
+        return True
+
     # ========== 鍵盤方法 ==========
 
     def keyboard_press(self, key: int) -> bool:
@@ -276,27 +707,164 @@ class ArduinoHID:
         params = struct.pack('>BH', key, duration_ms)
         return self._send_packet(self.CMD_KB_PRESS_TIMED, params)
 
-    def keyboard_print(self, text: str, check_interrupt: bool = True) -> bool:
+    @classmethod
+    def _z_tokens(cls, data: bytes) -> List[Tuple[int, bytes]]:
+        """
+        貪婪式 RLE + LZ 切分
+
+        Returns:
+            [(kind, payload)]: kind 0 為字元 (payload 為字元本身, 尚未切段),
+            1 為 RLE / LZ token (payload 為編碼好的 2 bytes)
+        """
+        tokens: List[Tuple[int, bytes]] = []
+        literal = bytearray()
+        heads = {}  # 3 字元前綴 → 出現位置 (新的在後)
+        n = len(data)
+        i = 0
+        while i < n:
+            limit = min(cls.Z_MAX_MATCH, n - i)
+            run = 1
+            while run < limit and data[i + run] == data[i]:
+                run += 1
+
+            best_len, best_dist = 0, 0
+            for pos in reversed(heads.get(data[i:i + 3], ())):
+                dist = i - pos
+                if dist > cls.Z_WINDOW:
+                    break
+                length = 0
+                while length < limit and data[pos + length] == data[i + length]:
+                    length += 1
+                if length > best_len:
+                    best_len, best_dist = length, dist
+                    if length == limit:
+                        break
+
+            if run >= cls.Z_MIN_MATCH and run >= best_len:
+                token, step = bytes([0x80 | (run - 3), data[i]]), run
+            elif best_len >= cls.Z_MIN_MATCH:
+                token, step = bytes([0xC0 | (best_len - 3), best_dist - 1]), best_len
+            else:
+                token, step = None, 1
+                literal.append(data[i])
+
+            if token is not None:
+                if literal:
+                    tokens.append((0, bytes(literal)))
+                    literal.clear()
+                tokens.append((1, token))
+            for j in range(i, min(i + step, n - 2)):
+                chain = heads.setdefault(data[j:j + 3], [])
+                chain.append(j)
+                if len(chain) > 16:
+                    del chain[0]
+            i += step
+        if literal:
+            tokens.append((0, bytes(literal)))
+        return tokens
+
+    @classmethod
+    def compress_text(cls, data: bytes, max_params: int) -> List[bytes]:
+        """
+        將文字編碼成 CMD_KB_PRINT_Z 的 PARAMS, 依封包上限切成多段
+
+        第一段帶 Z_FLAG_RESET; 參照可以跨段, 韌體的視窗會延續, 所以必須依序送出。
+
+        Args:
+            data: ASCII 文字
+            max_params: 單一封包 PARAMS 上限 (max_payload - 1)
+        """
+        if max_params < 3:
+            raise ValueError(f"max_params too small: {max_params}")
+        frames = []
+        current = bytearray([cls.Z_FLAG_RESET])
+        for kind, payload in cls._z_tokens(data):
+            if kind == 1:
+                if len(current) + 2 > max_params:
+                    frames.append(bytes(current))
+                    current = bytearray([0])
+                current += payload
+                continue
+            while payload:
+                room = min(max_params - len(current) - 1, cls.Z_MAX_LITERAL)
+                if room < 1:
+                    frames.append(bytes(current))
+                    current = bytearray([0])
+                    continue
+                current.append(min(room, len(payload)) - 1)
+                current += payload[:room]
+                payload = payload[room:]
+        if len(current) > 1:
+            frames.append(bytes(current))
+        return frames
+
+    def keyboard_print(self, text: str, check_interrupt: bool = True, compress: bool = False) -> bool:
         """
         輸入字串(一次性發送)
 
         Args:
             text: 要輸入的文字
             check_interrupt: 是否在每個 chunk 後檢查中斷旗標
+            compress: 韌體支援時以 CMD_KB_PRINT_Z 壓縮傳送 (重複性高的文字, 例如 ASCII art)
         """
-        if len(text) > 30:
-            for i in range(0, len(text), 30):
+        if compress and self.features & self.FEATURE_KB_PRINT_Z:
+            for params in self.compress_text(text.encode('ascii', errors='ignore'), self.max_payload - 1):
+                if check_interrupt and self.interrupted:
+                    print("⚠️ 文字輸入被中斷")
+                    return False
+                if not self._send_packet(self.CMD_KB_PRINT_Z, params):
+                    return False
+            return True
+
+        chunk_size = self.max_payload - 1
+        if len(text) > chunk_size:
+            for i in range(0, len(text), chunk_size):
                 if check_interrupt and self.interrupted:
                     print("⚠️ 文字輸入被中斷")
                     return False
 
-                chunk = text[i:i + 30]
+                chunk = text[i:i + chunk_size]
                 if not self._send_packet(self.CMD_KB_PRINT, chunk.encode('ascii', errors='ignore')):
                     return False
             return True
         else:
             return self._send_packet(self.CMD_KB_PRINT, text.encode('ascii', errors='ignore'))
 
+    def keyboard_type(self, text: str, layout: Optional[str] = None, errors: str = 'strict',
+                      check_interrupt: bool = True) -> bool:
+        """
+        依鍵盤配置輸入文字: Host 編譯成 [MOD][USAGE] 後以 CMD_KB_USAGES 送出
+
+        編譯結果會被快取, 重複的句子不會重新編碼。韌體不支援 CMD_KB_USAGES 時,
+        只有 US 配置的純 ASCII 文字可以退回 keyboard_print (韌體以 US 配置逐字轉換),
+        其他情況丟出 ArduinoHIDException, 不會默默丟字或換錯鍵。
+
+        Args:
+            text: 要輸入的文字
+            layout: 鍵盤配置 (None 使用 self.keyboard_layout)
+            errors: 'strict' 有無法輸入的字元時丟出 hid_text.UnmappableTextError, 'skip' 略過
+            check_interrupt: 是否在每個 chunk 前檢查中斷旗標
+        """
+        layout = layout or self.keyboard_layout
+        compiled = hid_text.get_compiler(layout).compile_text(text, errors)
+        if compiled.skipped:
+            logger.warning(f"略過無法輸入的字元: {compiled.skipped!r}")
+        if not (self.features & self.FEATURE_KB_USAGES):
+            # errors='skip' 略過的字元也不交給韌體
+            typed = ''.join(c for c in text if c not in compiled.skipped)
+            if layout != 'us' or not typed.isascii():
+                raise ArduinoHIDException(
+                    f"firmware lacks CMD_KB_USAGES, cannot type layout '{layout}' text: {text!r}")
+            return self.keyboard_print(typed, check_interrupt)
+
+        for chunk in compiled.chunks(self.max_payload - 1):
+            if check_interrupt and self.interrupted:
+                print("⚠️ 文字輸入被中斷")
+                return False
+            if not self._send_packet(self.CMD_KB_USAGES, chunk):
+                return False
+        return True
+
     def keyboard_type_str(self, text: str, delay: float = 0.01, check_interrupt: bool = True) -> bool:
         """
         輸入文字(逐字元發送)
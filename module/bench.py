@@ -0,0 +1,207 @@
+"""
+Arduino HID 基準測試: 各 API 的 ACK 延遲與吞吐量
+
+預設對模擬器 (module.hid_emulator) 執行; 加上 --device 才會對實體 Arduino 送出按鍵/滑鼠,
+執行前請把焦點切到不會受影響的視窗。
+
+Run:
+    python -m module.bench
+    python -m module.bench --apis mouse_move hotkey --rate 500 --duration 3 --output bench.json
+    python -m module.bench --device --port COM5
+"""
+import argparse
+import json
+import math
+import platform
+import sys
+import time
+from typing import Callable, Dict, List, Optional, Sequence
+
+from module.arduino_hid import ArduinoHID, ArduinoHIDException
+from module.hid_emulator import EmulatedSerial
+
+
+def percentiles(samples: Sequence[float], points: Sequence[float] = (50, 90, 99, 99.9)) -> Dict[str, float]:
+    """最近秩 (nearest-rank) 百分位數, key 例如 p50 / p99 / p999"""
+    if not samples:
+        return {}
+    ordered = sorted(samples)
+    result = {}
+    for p in points:
+        rank = min(len(ordered), max(1, math.ceil(p * len(ordered) / 100.0 - 1e-9)))
+        result[f"p{p:g}".replace('.', '')] = ordered[rank - 1]
+    result['min'] = ordered[0]
+    result['max'] = ordered[-1]
+    result['mean'] = sum(ordered) / len(ordered)
+    return result
+
+
+class TimedArduinoHID(ArduinoHID):
+    """記錄每個封包從送出到收到 ACK 的時間 (秒)"""
+
+    def __init__(self, *args, **kwargs):
+        self.ack_latencies: List[float] = []
+        super().__init__(*args, **kwargs)
+
+    def _send_packet(self, cmd: int, params: bytes = b'') -> bool:
+        start = time.perf_counter()
+        try:
+            return super()._send_packet(cmd, params)
+        finally:
+            self.ack_latencies.append(time.perf_counter() - start)
+
+
+def _api_calls(hid: ArduinoHID, text_len: int, press_ms: int) -> Dict[str, Callable[[int], object]]:
+    """每個 API 的單次呼叫 (參數 i 為呼叫序號)"""
+    text = ('benchmark ' * (text_len // 10 + 1))[:text_len]
+    return {
+        'mouse_move': lambda i: hid.mouse_move(1 if i % 2 else -1, 0),
+        'mouse_click': lambda i: hid.mouse_click(hid.MOUSE_MIDDLE),
+        'keyboard_print': lambda i: hid.keyboard_print(text),
+        'hotkey': lambda i: hid.hotkey(hid.KEY_LEFT_CTRL, hid.KEY_LEFT_SHIFT, hold_time=0),
+        'keyboard_press_timed': lambda i: hid.keyboard_press_timed(hid.KEY_LEFT_SHIFT, press_ms),
+        'mouse_press_timed': lambda i: hid.mouse_press_timed(hid.MOUSE_MIDDLE, press_ms),
+    }
+
+
+def bench_api(hid: TimedArduinoHID, name: str, call: Callable[[int], object],
+              rate: float, duration: float, max_calls: Optional[int]) -> dict:
+    """
+    以固定速率 (rate 次/秒, 0 = 盡快) 呼叫 API, 回傳延遲與吞吐量統計
+
+    延遲以封包為單位 (送出到收到 ACK), 吞吐量同時回報 API 呼叫數與封包數。
+    """
+    hid.clear_queue()  # 上一個 API 留下的指令不計入
+    hid.ack_latencies.clear()
+    hid.reset_stats()
+
+    errors = 0
+    calls = 0
+    start = time.perf_counter()
+    deadline = start + duration
+    while True:
+        now = time.perf_counter()
+        if now >= deadline or (max_calls is not None and calls >= max_calls):
+            break
+        if rate > 0:
+            next_at = start + calls / rate
+            if next_at > now:
+                time.sleep(next_at - now)
+        try:
+            call(calls)
+        except ArduinoHIDException:
+            errors += 1
+        calls += 1
+    elapsed = time.perf_counter() - start
+
+    stats = dict(hid.stats)
+    latencies_us = [t * 1e6 for t in hid.ack_latencies]
+    return {
+        'api': name,
+        'target_rate': rate,
+        'calls': calls,
+        'errors': errors,
+        'packets': stats['packets'],
+        'duration_s': elapsed,
+        'calls_per_sec': calls / elapsed if elapsed > 0 else 0.0,
+        'commands_per_sec': stats['packets'] / elapsed if elapsed > 0 else 0.0,
+        'ack_latency_us': percentiles(latencies_us, (50, 99, 99.9)),
+        'retries': stats['retries'],
+        'timeouts': stats['timeouts'],
+        'crc_errors': stats['crc_errors'],
+        'queue_full': stats['queue_full'],
+    }
+
+
+def open_hid(args) -> TimedArduinoHID:
+    if args.device:
+        return TimedArduinoHID(port=args.port)
+    emu = EmulatedSerial(ack_latency=args.emu_latency / 1e6)
+    return TimedArduinoHID(ser=emu, negotiate=not args.v1)
+
+
+def run(args) -> dict:
+    report = {
+        'meta': {
+            'target': 'device' if args.device else 'emulator',
+            'port': args.port,
+            'python': platform.python_version(),
+            'platform': platform.platform(),
+            'time': time.strftime('%Y-%m-%dT%H:%M:%S'),
+            'rate': args.rate,
+            'duration_s': args.duration,
+        },
+        'results': [],
+    }
+
+    with open_hid(args) as hid:
+        report['meta']['frame_v2'] = hid.frame_v2
+        report['meta']['max_payload'] = hid.max_payload
+        calls = _api_calls(hid, args.text_len, args.press_ms)
+        unknown = [name for name in args.apis if name not in calls]
+        if unknown:
+            raise SystemExit(f"unknown api: {', '.join(unknown)} (choices: {', '.join(calls)})")
+
+        if args.device:
+            hid.pause_logging()
+        try:
+            for name in args.apis:
+                report['results'].append(
+                    bench_api(hid, name, calls[name], args.rate, args.duration, args.max_calls))
+        finally:
+            if args.device:
+                hid.resume_logging()
+    return report
+
+
+def print_report(report: dict):
+    meta = report['meta']
+    print(f"target={meta['target']} frame={'V2' if meta.get('frame_v2') else 'V1'} "
+          f"rate={meta['rate']}/s duration={meta['duration_s']}s")
+    print(f"{'api':<22}{'calls/s':>10}{'cmds/s':>10}{'p50us':>9}{'p99us':>9}{'p999us':>9}"
+          f"{'retry':>7}{'qfull':>7}{'err':>5}")
+    for r in report['results']:
+        lat = r['ack_latency_us']
+        print(f"{r['api']:<22}{r['calls_per_sec']:>10.1f}{r['commands_per_sec']:>10.1f}"
+              f"{lat.get('p50', 0):>9.0f}{lat.get('p99', 0):>9.0f}{lat.get('p999', 0):>9.0f}"
+              f"{r['retries']:>7}{r['queue_full']:>7}{r['errors']:>5}")
+
+
+def build_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(description="Arduino HID per-API latency/throughput benchmark")
+    parser.add_argument('--apis', nargs='+',
+                        default=['mouse_move', 'keyboard_print', 'hotkey', 'keyboard_press_timed'])
+    parser.add_argument('--rate', type=float, default=0, help="calls/sec per API (0 = as fast as possible)")
+    parser.add_argument('--duration', type=float, default=2.0, help="seconds per API")
+    parser.add_argument('--max-calls', type=int, default=None, help="stop each API after N calls")
+    parser.add_argument('--text-len', type=int, default=64, help="keyboard_print text length")
+    parser.add_argument('--press-ms', type=int, default=1, help="duration for *_press_timed")
+    parser.add_argument('--device', action='store_true', help="use a real Arduino instead of the emulator")
+    parser.add_argument('--port', default=None, help="COM port for --device (default: auto detect)")
+    parser.add_argument('--emu-latency', type=float, default=500, help="emulator ACK latency (us)")
+    parser.add_argument('--v1', action='store_true', help="emulator: stay on V1 frames")
+    parser.add_argument('--output', default=None, help="write JSON report to file")
+    parser.add_argument('--json', action='store_true', help="print JSON report")
+    return parser
+
+
+def main(argv=None) -> int:
+    args = build_parser().parse_args(argv)
+    try:
+        report = run(args)
+    except ArduinoHIDException as e:
+        print(f"❌ 錯誤: {e}")
+        return 1
+
+    if args.output:
+        with open(args.output, 'w', encoding='utf-8') as f:
+            json.dump(report, f, indent=2)
+    if args.json:
+        print(json.dumps(report, indent=2))
+    else:
+        print_report(report)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,460 @@
+"""
+Arduino HID 韌體模擬器 (serial-like 物件)
+
+在 Host 端模擬 ino_/ardunio_code 的協議行為: V1/V2 封包解析, ACK, 回應封包,
+以位元組池為上限的指令佇列, 以及依指令成本消化佇列的執行時間。
+可以直接交給 ArduinoHID(ser=...) 使用, 不需要實體裝置。
+
+Example:
+    from module.arduino_hid import ArduinoHID
+    from module.hid_emulator import EmulatedSerial
+
+    hid = ArduinoHID(ser=EmulatedSerial())
+    hid.mouse_move(10, 0)
+"""
+import struct
+import time
+from collections import Counter, deque
+from typing import Callable, Dict, Iterator, Optional, Tuple
+
+from module import hid_frame
+from module.arduino_hid import ArduinoHID as P
+
+# 每個指令在 Arduino 上的執行成本 (秒), USB HID 每 1ms 送出一個 report
+DEFAULT_EXEC_COST: Dict[int, float] = {
+    P.CMD_MOUSE_MOVE: 0.001,
+    P.CMD_MOUSE_PRESS: 0.001,
+    P.CMD_MOUSE_RELEASE: 0.001,
+    P.CMD_MOUSE_CLICK: 0.002,
+    P.CMD_KB_PRESS: 0.001,
+    P.CMD_KB_RELEASE: 0.001,
+    P.CMD_KB_WRITE: 0.002,
+    P.CMD_KB_RELEASE_ALL: 0.001,
+}
+KB_PRINT_COST_PER_CHAR = 0.002
+KB_USAGES_COST_PER_REPORT = 0.001  # CMD_KB_USAGES: 每個按鍵 2 個 report, modifier 切換各 1 個
+RX_FRAME_TIMEOUT = 0.010  # 韌體 RX_FRAME_TIMEOUT_MS
+QUEUE_HOLD = 0.050  # 韌體 QUEUE_HOLD_MS: 拒收後等待重送的上限
+
+# 中斷按鈕: 這些指令每個 report 前檢查中斷 (或本身不阻塞), 其餘指令要執行完才釋放
+ABORTABLE_COMMANDS = {
+    P.CMD_KB_PRINT, P.CMD_KB_USAGES, P.CMD_KB_PRINT_Z, P.CMD_MOUSE_PRESS_TIMED, P.CMD_KB_PRESS_TIMED,
+    P.CMD_MOUSE_DRAG,
+}
+ABORT_POLL_INTERVAL = 0.002  # 兩次中斷檢查之間最多一個 Keyboard.write (2 個 report)
+ABORT_RELEASE_COST = 0.002  # releaseAll + Mouse.release
+ABORT_BOUND_US = 5000
+
+# CMD_GET_MEMINFO 回應用的 ATmega32u4 記憶體配置 (bytes), 佇列以外為估計值
+RAM_SIZE = 2560
+STATIC_EXCEPT_QUEUE = 760
+STACK_MAX = 310
+
+IMMEDIATE_COMMANDS = {
+    P.CMD_PAUSE_LOG, P.CMD_RESUME_LOG, P.CMD_CLEAR_QUEUE,
+    P.CMD_GET_CAPS, P.CMD_GET_MEMINFO, P.CMD_ECHO, P.CMD_SINK,
+    P.CMD_GET_ABORT_STATS,
+}
+
+
+def usage_reports(params: bytes) -> int:
+    """CMD_KB_USAGES 在韌體上送出的 report 數 (按鍵按下/放開 + modifier 位元切換)"""
+    reports = 0
+    held = 0
+    for i in range(0, len(params) - 1, 2):
+        mod, usage = params[i], params[i + 1]
+        reports += bin(held ^ mod).count('1') + (2 if usage else 0)
+        held = mod
+    return reports + bin(held).count('1')
+
+
+def z_output_length(params: bytes) -> int:
+    """CMD_KB_PRINT_Z 解碼後的字元數 (不需要視窗內容)"""
+    total = 0
+    i = 1
+    while i < len(params):
+        token = params[i]
+        if token < 0x80:
+            total += token + 1
+            i += token + 2
+        else:
+            total += (token & 0x3F) + 3
+            i += 2
+    return total
+
+
+def _c_div(a: int, b: int) -> int:
+    """C 的整數除法 (向 0 截斷), Python 的 // 向負無限大取整"""
+    q = abs(a) // b
+    return -q if a < 0 else q
+
+
+def drag_steps(dx: int, dy: int, duration_ms: int) -> Iterator[Tuple[int, int]]:
+    """與韌體 serviceDrag 相同的 report 序列 (每次 loop 以 1ms 計)"""
+    sent_x = sent_y = 0
+    elapsed = 0
+    while True:
+        if elapsed < duration_ms:
+            target_x, target_y = _c_div(dx * elapsed, duration_ms), _c_div(dy * elapsed, duration_ms)
+        else:
+            target_x, target_y = dx, dy
+        step_x = max(-127, min(127, target_x - sent_x))
+        step_y = max(-127, min(127, target_y - sent_y))
+        if step_x or step_y:
+            yield step_x, step_y
+            sent_x, sent_y = sent_x + step_x, sent_y + step_y
+        if (sent_x, sent_y) == (dx, dy) and elapsed >= duration_ms:
+            return
+        elapsed += 1
+
+
+class ZDecoder:
+    """與韌體 decodePrintZ 相同的解碼器, 視窗跨封包保留"""
+
+    def __init__(self):
+        self.window = bytearray()
+
+    def decode(self, params: bytes) -> Optional[bytes]:
+        """回傳輸出的字元; 格式錯誤回傳 None (與韌體相同, 清空視窗)"""
+        if params[0] & P.Z_FLAG_RESET:
+            self.window.clear()
+        out = bytearray()
+        i = 1
+        while i < len(params):
+            token = params[i]
+            i += 1
+            if token < 0x80:
+                count = token + 1
+                if len(params) - i < count:
+                    break
+                out += params[i:i + count]
+                i += count
+                continue
+            if i >= len(params):
+                break
+            arg = params[i]
+            i += 1
+            count = (token & 0x3F) + 3
+            if token < 0xC0:
+                out += bytes([arg]) * count
+                continue
+            dist = arg + 1
+            history = (self.window + out)[-P.Z_WINDOW:]
+            if dist > len(history):
+                break
+            for _ in range(count):
+                history.append(history[-dist])
+                out.append(history[-1])
+        else:
+            self.window = (self.window + out)[-P.Z_WINDOW:]
+            return bytes(out)
+        self.window.clear()
+        return None
+
+
+class EmulatedSerial:
+    """
+    模擬 Arduino HID 韌體的 serial 物件 (write / read / in_waiting)
+
+    Args:
+        timeout: read() 逾時 (秒), None 表示無限等待
+        ack_latency: 裝置回覆抵達 Host 的延遲 (秒)
+        pool_size: 佇列位元組池大小 (與韌體 QUEUE_POOL_SIZE 相同)
+        exec_cost: 覆寫個別指令的執行成本 {cmd: 秒}
+        record: 記錄每個被執行的指令到 executed (Counter)
+        clock: 時間來源
+    """
+
+    def __init__(self, timeout: Optional[float] = 0.1, ack_latency: float = 0.0005,
+                 pool_size: int = 640, exec_cost: Optional[Dict[int, float]] = None,
+                 record: bool = False, clock: Callable[[], float] = time.perf_counter):
+        self.timeout = timeout
+        self.ack_latency = ack_latency
+        self.pool_size = pool_size
+        self.exec_cost = dict(DEFAULT_EXEC_COST)
+        if exec_cost:
+            self.exec_cost.update(exec_cost)
+        self.record = record
+        self.clock = clock
+        self.is_open = True
+
+        self.executed = Counter()  # (cmd, params) -> 次數
+        self.executed_count = 0
+        self.abort_stats = {'count': 0, 'over_bound': 0, 'last_us': 0, 'max_us': 0}
+        self.typed = bytearray()  # record 時, KB_PRINT / KB_PRINT_Z 輸出的文字
+        self._z = ZDecoder()
+
+        self._out = deque()  # [ready_time, bytearray]
+        self._queue = deque()  # (arrival, cmd, params, entry_size)
+        self._pool_used = 0
+        self._busy_until = 0.0
+        self._paused = False
+        self._hold = None  # (len, crc, 時間): 拒收中, 等待被拒收的封包重送
+
+        # 接收狀態機
+        self._state = 0
+        self._last_byte = 0.0
+        self._v2 = False
+        self._len = 0
+        self._frame = bytearray()
+        self._sink_total = 0
+        self._sink_received = 0
+        self._sink_start = 0.0
+
+    # ========== serial 介面 ==========
+
+    def write(self, data) -> int:
+        data = bytes(data)
+        now = self.clock()
+        self._drain(now)
+        for byte in data:
+            self._feed(byte, now)
+        return len(data)
+
+    def read(self, size: int = 1) -> bytes:
+        deadline = None if self.timeout is None else self.clock() + self.timeout
+        result = bytearray()
+        while len(result) < size:
+            now = self.clock()
+            self._take_ready(result, size, now)
+            if len(result) >= size:
+                break
+            wait_until = self._out[0][0] if self._out else None
+            if deadline is not None and (wait_until is None or wait_until > deadline):
+                if now >= deadline:
+                    break
+                wait_until = deadline
+            if wait_until is None:
+                break
+            time.sleep(max(0.0, wait_until - now))
+        return bytes(result)
+
+    @property
+    def in_waiting(self) -> int:
+        now = self.clock()
+        return sum(len(chunk) for ready, chunk in self._out if ready <= now)
+
+    def flush(self):
+        pass
+
+    def reset_input_buffer(self):
+        self._out.clear()
+
+    def reset_output_buffer(self):
+        pass
+
+    def close(self):
+        self.is_open = False
+
+    def wait_idle(self, timeout: float = 5.0) -> bool:
+        """等待佇列中的指令全部執行完畢 (暫停中會直接回傳 False)"""
+        deadline = self.clock() + timeout
+        while self._queue and not self._paused:
+            now = self.clock()
+            self._drain(now)
+            if not self._queue or now >= deadline:
+                break
+            time.sleep(0.001)
+        return not self._queue
+
+    # ========== 模擬硬體按鈕 ==========
+
+    def press_abort_button(self):
+        """模擬 BTN_ACTION_ABORT: 釋放按鍵, 清空佇列並通知 Host, 記錄 ISR 到釋放的延遲"""
+        now = self.clock()
+        self._drain(now)
+        wait = 0.0
+        if self._queue and not self._paused:
+            arrival, cmd, params, _ = self._queue[0]
+            start = max(self._busy_until, arrival)
+            if start <= now:
+                remaining = start + self._cost(cmd, params) - now
+                wait = min(remaining, ABORT_POLL_INTERVAL) if cmd in ABORTABLE_COMMANDS else remaining
+        latency_us = int((wait + ABORT_RELEASE_COST) * 1e6)
+        stats = self.abort_stats
+        stats['count'] += 1
+        stats['last_us'] = latency_us
+        stats['max_us'] = max(stats['max_us'], latency_us)
+        stats['over_bound'] += latency_us > ABORT_BOUND_US
+
+        self._queue.clear()
+        self._pool_used = 0
+        self._busy_until = now + latency_us / 1e6
+        self._reply(bytes([P.ACK_INTERRUPTED]), self._busy_until)
+
+    def toggle_pause_button(self):
+        """模擬 BTN_ACTION_PAUSE_QUEUE"""
+        now = self.clock()
+        self._drain(now)
+        self._paused = not self._paused
+        if not self._paused:
+            self._busy_until = max(self._busy_until, now)
+        self._reply(bytes([P.EVT_MARKER, P.EVT_QUEUE_PAUSED, int(self._paused)]), now)
+
+    # ========== 內部 ==========
+
+    def _reply(self, data: bytes, now: float):
+        self._out.append([now + self.ack_latency, bytearray(data)])
+
+    def _respond(self, payload: bytes, now: float):
+        length = bytes([len(payload)])
+        crc = hid_frame.crc16(length + payload)
+        self._reply(bytes([P.RESP_MARKER]) + length + payload + crc.to_bytes(2, 'big'), now)
+
+    def _take_ready(self, result: bytearray, size: int, now: float):
+        while self._out and len(result) < size and self._out[0][0] <= now:
+            chunk = self._out[0][1]
+            n = size - len(result)
+            result += chunk[:n]
+            del chunk[:n]
+            if not chunk:
+                self._out.popleft()
+
+    def _cost(self, cmd: int, params: bytes) -> float:
+        if cmd == P.CMD_KB_PRINT:
+            return KB_PRINT_COST_PER_CHAR * len(params)
+        if cmd == P.CMD_KB_USAGES:
+            return KB_USAGES_COST_PER_REPORT * usage_reports(params)
+        if cmd == P.CMD_KB_PRINT_Z:
+            return KB_PRINT_COST_PER_CHAR * z_output_length(params)
+        if cmd in (P.CMD_MOUSE_PRESS_TIMED, P.CMD_KB_PRESS_TIMED) and len(params) == 3:
+            return struct.unpack('>BH', params)[1] / 1000.0
+        if cmd == P.CMD_MOUSE_DRAG and len(params) == 11:
+            duration, press_settle, release_settle = struct.unpack('>HHH', params[5:])
+            return max(0.001, (duration + press_settle + release_settle) / 1000.0)
+        return self.exec_cost.get(cmd, 0.001)
+
+    def _drain(self, now: float):
+        """執行到 now 為止已完成的指令, 釋放佇列空間"""
+        if self._paused:
+            return
+        while self._queue:
+            arrival, cmd, params, size = self._queue[0]
+            start = max(self._busy_until, arrival)
+            end = start + self._cost(cmd, params)
+            if end > now:
+                break
+            self._queue.popleft()
+            self._pool_used -= size
+            self._busy_until = end
+            self._execute(cmd, params)
+
+    def _execute(self, cmd: int, params: bytes):
+        self.executed_count += 1
+        if cmd == P.CMD_KB_PRINT_Z and params:
+            typed = self._z.decode(params)
+        else:
+            typed = params if cmd == P.CMD_KB_PRINT else None
+        if self.record:
+            self.executed[(cmd, params)] += 1
+            if typed:
+                self.typed += typed
+        if cmd == P.CMD_MOUSE_MOVE and len(params) == 3:
+            self._pointer_move((params[0] ^ 0x80) - 0x80, (params[1] ^ 0x80) - 0x80)
+        elif cmd == P.CMD_MOUSE_DRAG and len(params) == 11:
+            _, dx, dy, duration, _, _ = struct.unpack('>BhhHHH', params)
+            for step_x, step_y in drag_steps(dx, dy, duration):
+                self._pointer_move(step_x, step_y)
+
+    def _pointer_move(self, dx: int, dy: int):
+        """每個滑鼠移動 report; 子類別覆寫以模擬游標"""
+
+    def _feed(self, byte: int, now: float):
+        if self._state in (1, 2) and now - self._last_byte > RX_FRAME_TIMEOUT:
+            self._state = 0  # 與韌體相同, 未完成的封包逾時丟棄
+        self._last_byte = now
+        if self._state == 0:  # 等待 SYNC
+            if byte in (P.SYNC_BYTE, P.SYNC_BYTE_V2):
+                self._v2 = byte == P.SYNC_BYTE_V2
+                self._frame = bytearray()
+                self._state = 1
+        elif self._state == 1:  # 讀取 LEN
+            max_len = P.MAX_PAYLOAD_V2 if self._v2 else P.MAX_PAYLOAD_V1
+            if byte == 0 or byte > max_len:
+                self._reply(bytes([P.ACK_PARAM_ERROR]), now)
+                self._state = 0
+            else:
+                self._len = byte
+                self._state = 2
+        elif self._state == 2:  # 讀取 DATA + CRC
+            self._frame.append(byte)
+            if len(self._frame) == self._len + (2 if self._v2 else 1):
+                self._state = 0
+                self._finish_frame(now)
+        elif self._state == 3:  # SINK
+            if self._sink_received == 0:
+                self._sink_start = now
+            self._sink_received += 1
+            if self._sink_received == self._sink_total:
+                self._finish_sink(now)
+
+    def _finish_frame(self, now: float):
+        data = bytes(self._frame[:self._len])
+        rx_crc = int.from_bytes(self._frame[self._len:], 'big')
+        if self._hold and ((self._len, rx_crc) == self._hold[:2] or now - self._hold[2] >= QUEUE_HOLD):
+            self._hold = None
+        if self._v2:
+            crc_ok = hid_frame.crc16(bytes([self._len]) + data) == rx_crc
+        else:
+            crc_ok = hid_frame.crc8(data) == rx_crc
+        if not crc_ok:
+            self._reject(P.ACK_CRC_ERROR, rx_crc, now)
+            return
+
+        cmd, params = data[0], data[1:]
+        if cmd in IMMEDIATE_COMMANDS:
+            self._reply(bytes([P.ACK_SUCCESS]), now)
+            self._immediate(cmd, params, now)
+            return
+
+        size = 2 + self._len + (2 if self._v2 else 1)
+        if self._hold or self._pool_used + size > self.pool_size:
+            self._reject(P.ACK_QUEUE_FULL, rx_crc, now)
+            return
+        if not self._queue:
+            self._busy_until = max(self._busy_until, now)
+        self._queue.append((now, cmd, params, size))
+        self._pool_used += size
+        self._reply(bytes([P.ACK_SUCCESS]), now)
+
+    def _reject(self, ack_code: int, rx_crc: int, now: float):
+        """與韌體 rejectFrame 相同: 記住第一個被拒收的封包, 之後的封包拒收到它重送為止"""
+        if self._hold is None:
+            self._hold = (self._len, rx_crc, now)
+        self._reply(bytes([ack_code]), now)
+
+    def _immediate(self, cmd: int, params: bytes, now: float):
+        if cmd == P.CMD_CLEAR_QUEUE:
+            self._queue.clear()
+            self._pool_used = 0
+        elif cmd == P.CMD_GET_CAPS:
+            features = (P.FEATURE_FRAME_V2 | P.FEATURE_LOOPBACK | P.FEATURE_MEMINFO | P.FEATURE_KB_USAGES |
+                        P.FEATURE_KB_PRINT_Z | P.FEATURE_ABORT_STATS | P.FEATURE_MOUSE_DRAG)
+            self._respond(struct.pack('>BBBH', 2, features, P.MAX_PAYLOAD_V2, self.pool_size), now)
+        elif cmd == P.CMD_GET_MEMINFO:
+            static = STATIC_EXCEPT_QUEUE + self.pool_size + 6
+            free = max(0, RAM_SIZE - static - STACK_MAX)
+            sizes = [(0x01, self.pool_size + 6), (0x02, 47), (0x03, 12), (0x04, 30),
+                     (0x05, 16), (0x06, 26), (0x07, 157), (0x08, P.Z_WINDOW + 2)]
+            payload = struct.pack('>HHHHHB', RAM_SIZE, static, free + 40, free, STACK_MAX, len(sizes))
+            payload += b''.join(struct.pack('>BH', mem_id, size) for mem_id, size in sizes)
+            self._respond(payload, now)
+        elif cmd == P.CMD_GET_ABORT_STATS:
+            stats = self.abort_stats
+            self._respond(struct.pack('>HHIII', stats['count'], stats['over_bound'], stats['last_us'],
+                                      stats['max_us'], ABORT_BOUND_US), now)
+        elif cmd == P.CMD_ECHO:
+            self._respond(params, now)
+        elif cmd == P.CMD_SINK and len(params) == 4:
+            self._sink_total = struct.unpack('>I', params)[0]
+            self._sink_received = 0
+            if self._sink_total == 0:
+                self._finish_sink(now)
+            else:
+                self._state = 3
+
+    def _finish_sink(self, now: float):
+        elapsed_us = int((now - self._sink_start) * 1e6) if self._sink_received else 0
+        self._respond(struct.pack('>II', self._sink_received, elapsed_us), now)
+        self._sink_total = 0
+        self._state = 0
@@ -0,0 +1,247 @@
+"""
+序列埠錯誤注入與 goodput 基準測試
+
+FaultySerial 包在任何 serial-like 物件 (serial.Serial / EmulatedSerial) 外面,
+依設定的機率丟棄 / 翻轉 / 重複位元組, 用來量測協議在雜訊下的恢復能力:
+SYNC 重新對齊, CRC 拒收, Host 重試。
+
+goodput 測試送出 N 個參數互不相同的 mouse_move, 由模擬器記錄實際執行的指令,
+計算有效指令數/秒, 重複執行, 遺失, 以及發生錯誤的指令花了多久才恢復。
+
+Run:
+    python -m module.hid_fault
+    python -m module.hid_fault --drop 0.001 0.01 --flip 0.001 --count 2000 --json
+"""
+import argparse
+import json
+import random
+import sys
+import time
+from typing import Dict, List, Optional
+
+from module.arduino_hid import ArduinoHID, ArduinoHIDException
+from module.bench import percentiles
+from module.hid_emulator import EmulatedSerial
+
+
+class FaultySerial:
+    """
+    在 Host 與裝置之間注入位元組錯誤
+
+    Args:
+        inner: 被包裝的 serial 物件
+        drop: 每個位元組被丟棄的機率
+        flip: 每個位元組被翻轉一個位元的機率
+        dup: 每個位元組被重複送出的機率
+        direction: 'tx' (Host→裝置), 'rx' (裝置→Host) 或 'both'
+        seed: 亂數種子, 相同種子產生相同的錯誤序列
+    """
+
+    def __init__(self, inner, drop: float = 0.0, flip: float = 0.0, dup: float = 0.0,
+                 direction: str = 'both', seed: Optional[int] = None):
+        if direction not in ('tx', 'rx', 'both'):
+            raise ValueError(f"direction must be 'tx', 'rx' or 'both', got {direction!r}")
+        self.inner = inner
+        self.drop = drop
+        self.flip = flip
+        self.dup = dup
+        self.direction = direction
+        self.rng = random.Random(seed)
+        self.injected = {'tx_drop': 0, 'tx_flip': 0, 'tx_dup': 0,
+                         'rx_drop': 0, 'rx_flip': 0, 'rx_dup': 0}
+        self._rx_pending = bytearray()  # rx 重複的位元組, 下次 read 優先回傳
+
+    def _corrupt(self, data: bytes, side: str) -> bytes:
+        if self.direction not in (side, 'both') or not (self.drop or self.flip or self.dup):
+            return data
+        out = bytearray()
+        rng = self.rng
+        for byte in data:
+            if rng.random() < self.drop:
+                self.injected[side + '_drop'] += 1
+                continue
+            if rng.random() < self.flip:
+                byte ^= 1 << rng.randrange(8)
+                self.injected[side + '_flip'] += 1
+            out.append(byte)
+            if rng.random() < self.dup:
+                out.append(byte)
+                self.injected[side + '_dup'] += 1
+        return bytes(out)
+
+    # ========== serial 介面 ==========
+
+    def write(self, data) -> int:
+        data = bytes(data)
+        self.inner.write(self._corrupt(data, 'tx'))
+        return len(data)  # 對 Host 而言整筆都送出了
+
+    def read(self, size: int = 1) -> bytes:
+        result = bytearray()
+        while len(result) < size:
+            if self._rx_pending:
+                n = size - len(result)
+                result += self._rx_pending[:n]
+                del self._rx_pending[:n]
+                continue
+            chunk = self.inner.read(size - len(result))
+            if not chunk:
+                break
+            corrupted = self._corrupt(chunk, 'rx')
+            n = size - len(result)
+            result += corrupted[:n]
+            self._rx_pending += corrupted[n:]
+        return bytes(result)
+
+    @property
+    def in_waiting(self) -> int:
+        return len(self._rx_pending) + self.inner.in_waiting
+
+    @property
+    def is_open(self) -> bool:
+        return self.inner.is_open
+
+    @property
+    def timeout(self):
+        return self.inner.timeout
+
+    @timeout.setter
+    def timeout(self, value):
+        self.inner.timeout = value
+
+    def flush(self):
+        self.inner.flush()
+
+    def reset_input_buffer(self):
+        self._rx_pending.clear()
+        self.inner.reset_input_buffer()
+
+    def reset_output_buffer(self):
+        self.inner.reset_output_buffer()
+
+    def close(self):
+        self.inner.close()
+
+
+# ========== goodput 基準測試 ==========
+
+def _move_params(i: int) -> tuple:
+    """第 i 個指令的 (dx, dy), 65025 個以內互不重複"""
+    return (i % 255) - 127, (i // 255) % 255 - 127
+
+
+def measure_goodput(drop: float, flip: float, dup: float, direction: str, count: int,
+                    seed: int, frame_v2: bool, ack_latency: float) -> dict:
+    """送出 count 個互不相同的 mouse_move, 比對模擬器實際執行的結果"""
+    emu = EmulatedSerial(ack_latency=ack_latency, record=True)
+    hid = ArduinoHID(ser=emu, negotiate=frame_v2)  # 協商在注入錯誤前完成
+    faulty = FaultySerial(emu, drop, flip, dup, direction, seed)
+    hid.ser = faulty
+    hid.reset_stats()
+
+    sent = {}
+    errors = 0
+    latencies: List[float] = []
+    recovery: List[float] = []
+    start = time.perf_counter()
+    for i in range(count):
+        x, y = _move_params(i)
+        sent[(ArduinoHID.CMD_MOUSE_MOVE, bytes([x & 0xFF, y & 0xFF, 0]))] = i
+        before = hid.stats['timeouts'] + hid.stats['crc_errors']
+        t0 = time.perf_counter()
+        failed = False
+        try:
+            hid.mouse_move(x, y)
+        except ArduinoHIDException:
+            errors += 1
+            failed = True
+        dt = time.perf_counter() - t0
+        latencies.append(dt)
+        if failed or hid.stats['timeouts'] + hid.stats['crc_errors'] != before:
+            recovery.append(dt)  # 佇列滿的重送不算錯誤恢復
+    elapsed = time.perf_counter() - start
+    emu.wait_idle()
+
+    executed_ok = duplicates = spurious = 0
+    for key, n in emu.executed.items():
+        if key in sent:
+            executed_ok += 1
+            duplicates += n - 1
+        else:
+            spurious += n  # 損毀後仍通過 CRC 的指令
+    lost = len(sent) - executed_ok
+
+    stats = dict(hid.stats)
+    return {
+        'drop': drop,
+        'flip': flip,
+        'dup': dup,
+        'direction': direction,
+        'frame': 'V2' if hid.frame_v2 else 'V1',
+        'commands': count,
+        'duration_s': elapsed,
+        'goodput_per_sec': executed_ok / elapsed if elapsed > 0 else 0.0,
+        'executed_once_or_more': executed_ok,
+        'duplicate_executions': duplicates,
+        'lost': lost,
+        'spurious': spurious,
+        'host_errors': errors,
+        'retries': stats['retries'],
+        'timeouts': stats['timeouts'],
+        'crc_errors': stats['crc_errors'],
+        'injected': dict(faulty.injected),
+        'latency_ms': {k: v * 1e3 for k, v in percentiles(latencies, (50, 99)).items()},
+        'recovery_ms': {k: v * 1e3 for k, v in percentiles(recovery, (50, 99)).items()},
+        'recovered_commands': len(recovery),
+    }
+
+
+def print_report(results: List[Dict]):
+    print(f"{'drop':>7}{'flip':>7}{'dup':>7}{'goodput/s':>11}{'dup-exec':>9}{'lost':>6}"
+          f"{'spur':>6}{'err':>5}{'retry':>7}{'recov':>7}{'rec p50ms':>11}{'rec p99ms':>11}")
+    for r in results:
+        rec = r['recovery_ms']
+        print(f"{r['drop']:>7g}{r['flip']:>7g}{r['dup']:>7g}{r['goodput_per_sec']:>11.1f}"
+              f"{r['duplicate_executions']:>9}{r['lost']:>6}{r['spurious']:>6}{r['host_errors']:>5}"
+              f"{r['retries']:>7}{r['recovered_commands']:>7}{rec.get('p50', 0):>11.1f}{rec.get('p99', 0):>11.1f}")
+
+
+def build_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(description="Arduino HID goodput under injected serial faults (emulator)")
+    parser.add_argument('--drop', type=float, nargs='+', default=[0, 0.001, 0.01],
+                        help="byte drop probabilities to sweep")
+    parser.add_argument('--flip', type=float, nargs='+', default=[0],
+                        help="bit flip probabilities to sweep")
+    parser.add_argument('--dup', type=float, nargs='+', default=[0],
+                        help="byte duplicate probabilities to sweep")
+    parser.add_argument('--direction', choices=['tx', 'rx', 'both'], default='both')
+    parser.add_argument('--count', type=int, default=1000, help="commands per run")
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--v1', action='store_true', help="stay on V1 frames")
+    parser.add_argument('--emu-latency', type=float, default=500, help="emulator ACK latency (us)")
+    parser.add_argument('--output', default=None, help="write JSON report to file")
+    parser.add_argument('--json', action='store_true', help="print JSON report")
+    return parser
+
+
+def main(argv=None) -> int:
+    args = build_parser().parse_args(argv)
+    results = []
+    for drop in args.drop:
+        for flip in args.flip:
+            for dup in args.dup:
+                results.append(measure_goodput(drop, flip, dup, args.direction, args.count,
+                                               args.seed, not args.v1, args.emu_latency / 1e6))
+
+    if args.output:
+        with open(args.output, 'w', encoding='utf-8') as f:
+            json.dump(results, f, indent=2)
+    if args.json:
+        print(json.dumps(results, indent=2))
+    else:
+        print_report(results)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
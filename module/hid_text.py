@@ -0,0 +1,242 @@
+"""
+鍵盤文字編譯器 (字串 → HID modifier + usage 序列)
+
+CMD_KB_PRINT 讓韌體以 Keyboard.write() 逐字轉換 ASCII, 而且只認得 US 配置。
+這裡改由 Host 依目標電腦的鍵盤配置, 把字串一次編譯成 [MOD][USAGE] 配對,
+交給 CMD_KB_USAGES 直接送出 report, 韌體不再做字元轉換。
+
+編譯結果以 (配置, 內容) 的雜湊快取, 重複輸入的句子不需要重新編碼。
+無法以該配置輸入的字元不會被默默丟掉: 預設丟出 UnmappableTextError,
+errors='skip' 時略過並記錄在 CompiledText.skipped。
+
+Example:
+    compiler = get_compiler('de')
+    compiled = compiler.compile_text("Grüße!")
+    hid.keyboard_type("Grüße!", layout='de')
+
+Run:
+    python -m module.hid_text "Hello, World!"
+    python -m module.hid_text "Grüße @ 10€" --layout de
+"""
+import argparse
+import hashlib
+import sys
+from collections import OrderedDict
+from typing import Dict, Iterator, NamedTuple, Tuple
+
+# HID modifier 位元 (與 report 的 modifier byte 相同)
+MOD_NONE = 0x00
+MOD_LCTRL = 0x01
+MOD_LSHIFT = 0x02
+MOD_LALT = 0x04
+MOD_LGUI = 0x08
+MOD_RALT = 0x40  # AltGr
+
+# HID usage (Keyboard/Keypad page)
+USAGE_A = 0x04
+USAGE_1 = 0x1E
+USAGE_0 = 0x27
+USAGE_ENTER = 0x28
+USAGE_TAB = 0x2B
+USAGE_SPACE = 0x2C
+USAGE_NON_US_HASH = 0x32
+USAGE_NON_US_BACKSLASH = 0x64
+
+Layout = Dict[str, Tuple[int, int]]
+
+
+def _base_layout(number_row_shifted: str) -> Layout:
+    """字母, 數字, 空白類字元, 以及數字列的 Shift 符號"""
+    layout: Layout = {
+        '\n': (MOD_NONE, USAGE_ENTER),
+        '\t': (MOD_NONE, USAGE_TAB),
+        ' ': (MOD_NONE, USAGE_SPACE),
+    }
+    for i in range(26):
+        layout[chr(ord('a') + i)] = (MOD_NONE, USAGE_A + i)
+        layout[chr(ord('A') + i)] = (MOD_LSHIFT, USAGE_A + i)
+    for i, digit in enumerate('1234567890'):
+        layout[digit] = (MOD_NONE, USAGE_1 + i)
+        if number_row_shifted[i] != ' ':
+            layout[number_row_shifted[i]] = (MOD_LSHIFT, USAGE_1 + i)
+    return layout
+
+
+def _add_keys(layout: Layout, keys: Dict[int, str]):
+    """keys: {usage: '一般 Shift [AltGr]'}, 空白表示該層沒有字元"""
+    for usage, chars in keys.items():
+        for mod, char in zip((MOD_NONE, MOD_LSHIFT, MOD_RALT), chars):
+            if char != ' ':
+                layout[char] = (mod, usage)
+
+
+def _us_layout() -> Layout:
+    layout = _base_layout('!@#$%^&*()')
+    _add_keys(layout, {
+        0x2D: '-_', 0x2E: '=+', 0x2F: '[{', 0x30: ']}', 0x31: '\\|',
+        0x33: ';:', 0x34: '\'"', 0x35: '`~', 0x36: ',<', 0x37: '.>', 0x38: '/?',
+    })
+    return layout
+
+
+def _uk_layout() -> Layout:
+    layout = _base_layout('!"£$%^&*()')
+    _add_keys(layout, {
+        0x2D: '-_', 0x2E: '=+', 0x2F: '[{', 0x30: ']}',
+        0x33: ';:', 0x34: '\'@', 0x35: '`¬', 0x36: ',<', 0x37: '.>', 0x38: '/?',
+        USAGE_NON_US_HASH: '#~', USAGE_NON_US_BACKSLASH: '\\|',
+    })
+    layout['€'] = (MOD_RALT, USAGE_1 + 3)
+    return layout
+
+
+def _de_layout() -> Layout:
+    # QWERTZ; 死鍵 (^ ´ `) 需要額外按空白, 不在表內
+    layout = _base_layout('!"§$%&/()=')
+    for lower, usage in (('z', 0x1C), ('y', 0x1D)):
+        layout[lower] = (MOD_NONE, usage)
+        layout[lower.upper()] = (MOD_LSHIFT, usage)
+    _add_keys(layout, {
+        0x2D: 'ß?\\', 0x2F: 'üÜ', 0x30: '+*~', 0x33: 'öÖ', 0x34: 'äÄ', 0x35: ' °',
+        0x36: ',;', 0x37: '.:', 0x38: '-_',
+        USAGE_NON_US_HASH: '#\'', USAGE_NON_US_BACKSLASH: '<>|',
+    })
+    for char, usage in (('²', USAGE_1 + 1), ('³', USAGE_1 + 2), ('{', USAGE_1 + 6), ('[', USAGE_1 + 7),
+                        (']', USAGE_1 + 8), ('}', USAGE_0), ('@', USAGE_A + 16), ('€', USAGE_A + 4),
+                        ('µ', USAGE_A + 12)):
+        layout[char] = (MOD_RALT, usage)
+    return layout
+
+
+LAYOUTS: Dict[str, Layout] = {
+    'us': _us_layout(),
+    'uk': _uk_layout(),
+    'de': _de_layout(),
+}
+
+
+class UnmappableTextError(ValueError):
+    """字串含有該鍵盤配置無法輸入的字元"""
+
+    def __init__(self, layout: str, chars: str):
+        super().__init__(f"layout '{layout}' cannot type: {chars!r}")
+        self.layout = layout
+        self.chars = chars
+
+
+class CompiledText(NamedTuple):
+    usages: bytes  # N x [MOD][USAGE]
+    skipped: str  # errors='skip' 時被略過的字元 (依出現順序, 不重複)
+    digest: bytes  # 快取鍵
+
+    @property
+    def keystrokes(self) -> int:
+        return len(self.usages) // 2
+
+    def chunks(self, max_params: int) -> Iterator[bytes]:
+        """依封包 PARAMS 上限切段, 不會把一組 [MOD][USAGE] 拆開"""
+        size = max_params & ~1
+        if size <= 0:
+            raise ValueError(f"max_params too small: {max_params}")
+        for i in range(0, len(self.usages), size):
+            yield self.usages[i:i + size]
+
+
+class TextCompiler:
+    """
+    以單一鍵盤配置編譯字串, 結果放在 LRU 快取
+
+    Args:
+        layout: LAYOUTS 的名稱
+        cache_size: 快取的最大句數
+    """
+
+    def __init__(self, layout: str = 'us', cache_size: int = 256):
+        if layout not in LAYOUTS:
+            raise ValueError(f"unknown layout '{layout}', choices: {', '.join(LAYOUTS)}")
+        self.layout = layout
+        self.cache_size = cache_size
+        self._table = LAYOUTS[layout]
+        self._cache: 'OrderedDict[bytes, CompiledText]' = OrderedDict()
+        self.stats = {'hits': 0, 'misses': 0}
+
+    def _digest(self, text: str, errors: str) -> bytes:
+        h = hashlib.blake2b(digest_size=16)
+        h.update(f"{self.layout}\0{errors}\0".encode())
+        h.update(text.encode('utf-8', errors='surrogatepass'))
+        return h.digest()
+
+    def compile_text(self, text: str, errors: str = 'strict') -> CompiledText:
+        """
+        字串 → CompiledText
+
+        Args:
+            text: 要輸入的文字, '\\r\\n' 視為一次 Enter
+            errors: 'strict' 遇到無法輸入的字元丟出 UnmappableTextError, 'skip' 略過
+        """
+        if errors not in ('strict', 'skip'):
+            raise ValueError("errors must be 'strict' or 'skip'")
+        digest = self._digest(text, errors)
+        cached = self._cache.get(digest)
+        if cached is not None:
+            self._cache.move_to_end(digest)
+            self.stats['hits'] += 1
+            return cached
+        self.stats['misses'] += 1
+
+        table = self._table
+        out = bytearray()
+        skipped = []
+        for char in text.replace('\r\n', '\n'):
+            key = table.get(char)
+            if key is None:
+                if char not in skipped:
+                    skipped.append(char)
+                continue
+            out += bytes(key)
+        if skipped and errors == 'strict':
+            raise UnmappableTextError(self.layout, ''.join(skipped))
+
+        compiled = CompiledText(bytes(out), ''.join(skipped), digest)
+        self._cache[digest] = compiled
+        if len(self._cache) > self.cache_size:
+            self._cache.popitem(last=False)
+        return compiled
+
+    def clear_cache(self):
+        self._cache.clear()
+
+
+_compilers: Dict[str, TextCompiler] = {}
+
+
+def get_compiler(layout: str = 'us') -> TextCompiler:
+    """每個配置共用一個 TextCompiler (與快取)"""
+    compiler = _compilers.get(layout)
+    if compiler is None:
+        compiler = _compilers[layout] = TextCompiler(layout)
+    return compiler
+
+
+def main(argv=None) -> int:
+    parser = argparse.ArgumentParser(description="Compile text into HID modifier/usage pairs")
+    parser.add_argument('text')
+    parser.add_argument('--layout', default='us', choices=sorted(LAYOUTS))
+    parser.add_argument('--skip', action='store_true', help="skip characters the layout cannot type")
+    args = parser.parse_args(argv)
+
+    try:
+        compiled = get_compiler(args.layout).compile_text(args.text, 'skip' if args.skip else 'strict')
+    except UnmappableTextError as e:
+        print(f"❌ {e}")
+        return 1
+    pairs = compiled.usages
+    print(' '.join(f"{pairs[i]:02X}:{pairs[i + 1]:02X}" for i in range(0, len(pairs), 2)))
+    print(f"{compiled.keystrokes} keystrokes, {len(pairs)} bytes, digest {compiled.digest.hex()}")
+    if compiled.skipped:
+        print(f"skipped: {compiled.skipped!r}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,471 @@
+"""
+Arduino HID 傳輸追蹤: 記錄與重播
+
+TracingSerial 包在 serial 物件外面, 把每次 write (Host→裝置的封包) 與 read
+(ACK / 事件 / 回應) 連同單調時鐘時間戳寫進二進位追蹤檔; 重播時依原速, N 倍速
+或盡快重送, 並比對每個封包得到的 ACK 與原本是否一致。
+
+追蹤檔格式 (little-endian, 可直接 mmap):
+    Header: [MAGIC 8s][VERSION u16][RESERVED u16][START_NS u64]    (20 bytes)
+    Record: [T_NS u64][KIND u8][LEN u16][DATA]                     (T_NS 相對於開始)
+
+KIND: TX (寫出的位元組), RX (讀到的位元組), TIMEOUT (read 未讀滿)
+超過 65535 bytes 的 write 會拆成多筆同時間戳的 TX。
+
+Example:
+    hid = ArduinoHID(trace='session.hidtrace')
+    ...
+    hid.close()
+
+Run:
+    python -m module.hid_trace info session.hidtrace
+    python -m module.hid_trace dump session.hidtrace --limit 50
+    python -m module.hid_trace replay session.hidtrace --speed 4
+    python -m module.hid_trace replay session.hidtrace --max --device --port COM5
+"""
+import argparse
+import json
+import mmap
+import struct
+import sys
+import time
+from typing import Iterator, List, NamedTuple, Optional, Tuple
+
+from module.bench import percentiles
+
+TRACE_MAGIC = b'HIDTRACE'
+TRACE_VERSION = 1
+HEADER = struct.Struct('<8sHHQ')
+RECORD = struct.Struct('<QBH')
+MAX_RECORD_DATA = 0xFFFF
+
+KIND_TX = 1
+KIND_RX = 2
+KIND_TIMEOUT = 3
+KIND_NAMES = {KIND_TX: 'TX', KIND_RX: 'RX', KIND_TIMEOUT: 'TIMEOUT'}
+
+# 與 ArduinoHID 相同的裝置端標記 (避免循環 import)
+EVT_MARKER = 0xF5
+RESP_MARKER = 0xF6
+
+
+class TraceWriter:
+    """追加寫入追蹤檔"""
+
+    def __init__(self, path: str):
+        self.path = path
+        self._file = open(path, 'wb')
+        self._start = time.perf_counter_ns()
+        self._file.write(HEADER.pack(TRACE_MAGIC, TRACE_VERSION, 0, time.time_ns()))
+        self.records = 0
+
+    def write(self, kind: int, data=b''):
+        t = time.perf_counter_ns() - self._start
+        view = memoryview(data)
+        while True:
+            chunk = view[:MAX_RECORD_DATA]
+            self._file.write(RECORD.pack(t, kind, len(chunk)))
+            self._file.write(chunk)
+            self.records += 1
+            view = view[MAX_RECORD_DATA:]
+            if not view:
+                break
+
+    def flush(self):
+        self._file.flush()
+
+    def close(self):
+        if not self._file.closed:
+            self._file.close()
+
+
+class TraceRecord(NamedTuple):
+    t_ns: int
+    kind: int
+    data: memoryview
+
+
+class TraceReader:
+    """以 mmap 讀取追蹤檔, 記錄的 data 是指向檔案內容的 memoryview (不複製)"""
+
+    def __init__(self, path: str):
+        self.path = path
+        self._file = open(path, 'rb')
+        self._map = mmap.mmap(self._file.fileno(), 0, access=mmap.ACCESS_READ)
+        self._view = memoryview(self._map)
+        if len(self._view) < HEADER.size:
+            raise ValueError(f"{path}: not a HID trace (too short)")
+        magic, version, _, self.start_unix_ns = HEADER.unpack_from(self._view, 0)
+        if magic != TRACE_MAGIC:
+            raise ValueError(f"{path}: not a HID trace (bad magic)")
+        if version != TRACE_VERSION:
+            raise ValueError(f"{path}: unsupported trace version {version}")
+
+    def __iter__(self) -> Iterator[TraceRecord]:
+        view = self._view
+        offset = HEADER.size
+        end = len(view)
+        while offset + RECORD.size <= end:
+            t_ns, kind, length = RECORD.unpack_from(view, offset)
+            offset += RECORD.size
+            if offset + length > end:
+                break  # 記錄中途被中斷的檔案
+            yield TraceRecord(t_ns, kind, view[offset:offset + length])
+            offset += length
+
+    def close(self):
+        try:
+            self._view.release()
+            self._map.close()
+        except BufferError:
+            pass  # 呼叫端仍持有記錄的 memoryview, mmap 交給 GC 關閉
+        self._file.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb):
+        self.close()
+
+
+class TracingSerial:
+    """記錄所有經過的位元組, 其餘行為與被包裝的 serial 物件相同"""
+
+    def __init__(self, inner, path: str):
+        self.inner = inner
+        self.writer = TraceWriter(path)
+
+    def write(self, data) -> int:
+        n = self.inner.write(data)
+        self.writer.write(KIND_TX, data)
+        return n
+
+    def read(self, size: int = 1) -> bytes:
+        data = self.inner.read(size)
+        if data:
+            self.writer.write(KIND_RX, data)
+        if len(data) < size:
+            self.writer.write(KIND_TIMEOUT)
+        return data
+
+    @property
+    def in_waiting(self) -> int:
+        return self.inner.in_waiting
+
+    @property
+    def is_open(self) -> bool:
+        return self.inner.is_open
+
+    @property
+    def timeout(self):
+        return self.inner.timeout
+
+    @timeout.setter
+    def timeout(self, value):
+        self.inner.timeout = value
+
+    def flush(self):
+        self.inner.flush()
+        self.writer.flush()
+
+    def reset_input_buffer(self):
+        self.inner.reset_input_buffer()
+
+    def reset_output_buffer(self):
+        self.inner.reset_output_buffer()
+
+    def close(self):
+        self.writer.close()
+        self.inner.close()
+
+
+# ========== 裝置回覆解析 ==========
+
+def parse_device_stream(data: bytes) -> Tuple[List[tuple], bytes]:
+    """
+    將裝置送回的位元組切成 token
+
+    Returns:
+        (tokens, rest): token 為 ('ACK', code) / ('EVT', evt, arg) / ('RESP', payload),
+        rest 為尚未完整的尾端位元組
+    """
+    tokens = []
+    i = 0
+    n = len(data)
+    while i < n:
+        code = data[i]
+        if code == EVT_MARKER:
+            if i + 3 > n:
+                break
+            tokens.append(('EVT', data[i + 1], data[i + 2]))
+            i += 3
+        elif code == RESP_MARKER:
+            if i + 2 > n or i + 2 + data[i + 1] + 2 > n:
+                break
+            length = data[i + 1]
+            tokens.append(('RESP', bytes(data[i + 2:i + 2 + length])))
+            i += 2 + length + 2
+        else:
+            tokens.append(('ACK', code))
+            i += 1
+    return tokens, bytes(data[i:])
+
+
+class Exchange(NamedTuple):
+    """一次 write 與它之後 (下一次 write 之前) 裝置的回覆"""
+    t_ns: int
+    tx: bytes
+    replies: List[tuple]  # 不含事件
+    events: List[tuple]
+    timeouts: int
+    first_reply_ns: Optional[int]
+
+
+def load_exchanges(reader: TraceReader) -> List[Exchange]:
+    exchanges = []
+    current = None
+    rx = bytearray()
+    timeouts = 0
+    first_reply = None
+
+    def close_current():
+        if current is None:
+            return
+        tokens, _ = parse_device_stream(bytes(rx))
+        replies = [tok for tok in tokens if tok[0] != 'EVT']
+        events = [tok for tok in tokens if tok[0] == 'EVT']
+        exchanges.append(Exchange(current[0], current[1], replies, events, timeouts, first_reply))
+
+    for rec in reader:
+        if rec.kind == KIND_TX:
+            # 同一時間戳的連續 TX 是被拆開的大 write
+            if current is not None and not rx and not timeouts and current[0] == rec.t_ns:
+                current = (current[0], current[1] + bytes(rec.data))
+                continue
+            close_current()
+            current = (rec.t_ns, bytes(rec.data))
+            rx = bytearray()
+            timeouts = 0
+            first_reply = None
+        elif current is None:
+            continue  # 開始記錄前殘留的回覆
+        elif rec.kind == KIND_RX:
+            if first_reply is None:
+                first_reply = rec.t_ns
+            rx += rec.data
+        elif rec.kind == KIND_TIMEOUT:
+            timeouts += 1
+    close_current()
+    return exchanges
+
+
+# ========== 重播 ==========
+
+def _read_replies(ser, pending: bytearray, count: int) -> Tuple[List[tuple], List[tuple], Optional[float], bool]:
+    """讀取 count 個非事件回覆; 回傳 (replies, events, 第一個位元組抵達時間, 是否逾時)"""
+    replies, events = [], []
+    first_at = None
+    while len(replies) < count:
+        tokens, rest = parse_device_stream(bytes(pending))
+        pending[:] = rest
+        for tok in tokens:
+            (events if tok[0] == 'EVT' else replies).append(tok)
+        if len(replies) >= count:
+            break
+        chunk = ser.read(1)
+        if not chunk:
+            return replies, events, first_at, True
+        if first_at is None:
+            first_at = time.perf_counter()
+        pending += chunk
+    return replies, events, first_at, False
+
+
+def replay(ser, exchanges: List[Exchange], speed: float = 1.0, max_mismatches: int = 20) -> dict:
+    """
+    重送追蹤中的每一次 write, 並比對 ACK / 回應
+
+    Args:
+        ser: serial 物件 (serial.Serial / EmulatedSerial)
+        exchanges: load_exchanges() 的結果
+        speed: 1 = 原速, N = N 倍速, 0 = 盡快 (只等 ACK)
+        max_mismatches: 報告中最多列出幾筆不一致
+
+    回應封包只比對是否存在, 內容 (例如 meminfo / sink 計時) 每次都不同。
+    """
+    pending = bytearray()
+    mismatches = []
+    mismatch_count = 0
+    timeouts = 0
+    replay_latency = []
+    original_latency = []
+    start = time.perf_counter()
+    base_ns = exchanges[0].t_ns if exchanges else 0
+
+    for idx, ex in enumerate(exchanges):
+        if speed > 0:
+            target = start + (ex.t_ns - base_ns) / 1e9 / speed
+            delay = target - time.perf_counter()
+            if delay > 0:
+                time.sleep(delay)
+
+        sent_at = time.perf_counter()
+        ser.write(ex.tx)
+        got, _, first_at, timed_out = _read_replies(ser, pending, len(ex.replies))
+        if timed_out:
+            timeouts += 1
+        if first_at is not None:
+            replay_latency.append(first_at - sent_at)
+        if ex.first_reply_ns is not None and ex.replies:
+            original_latency.append((ex.first_reply_ns - ex.t_ns) / 1e9)
+
+        expected = [tok if tok[0] == 'ACK' else ('RESP',) for tok in ex.replies]
+        actual = [tok if tok[0] == 'ACK' else ('RESP',) for tok in got]
+        if expected != actual:
+            mismatch_count += 1
+            if len(mismatches) < max_mismatches:
+                mismatches.append({
+                    'index': idx,
+                    't_ms': (ex.t_ns - base_ns) / 1e6,
+                    'tx': ex.tx[:16].hex(' '),
+                    'expected': [_token_str(tok) for tok in expected],
+                    'actual': [_token_str(tok) for tok in actual],
+                })
+
+    elapsed = time.perf_counter() - start
+    original = (exchanges[-1].t_ns - base_ns) / 1e9 if exchanges else 0.0
+    return {
+        'exchanges': len(exchanges),
+        'speed': speed,
+        'original_duration_s': original,
+        'replay_duration_s': elapsed,
+        'mismatches': mismatch_count,
+        'timeouts': timeouts,
+        'first_mismatches': mismatches,
+        'original_latency_us': {k: v * 1e6 for k, v in percentiles(original_latency, (50, 99)).items()},
+        'replay_latency_us': {k: v * 1e6 for k, v in percentiles(replay_latency, (50, 99)).items()},
+    }
+
+
+def _token_str(tok: tuple) -> str:
+    if tok[0] == 'ACK':
+        return f"0x{tok[1]:02X}"
+    if tok[0] == 'EVT':
+        return f"EVT(0x{tok[1]:02X},{tok[2]})"
+    return 'RESP'
+
+
+# ========== CLI ==========
+
+def cmd_info(args) -> int:
+    with TraceReader(args.trace) as reader:
+        counts = {name: 0 for name in KIND_NAMES.values()}
+        sizes = {name: 0 for name in KIND_NAMES.values()}
+        last_ns = 0
+        for rec in reader:
+            name = KIND_NAMES.get(rec.kind, str(rec.kind))
+            counts[name] = counts.get(name, 0) + 1
+            sizes[name] = sizes.get(name, 0) + len(rec.data)
+            last_ns = rec.t_ns
+        exchanges = load_exchanges(reader)
+        start = time.strftime('%Y-%m-%d %H:%M:%S', time.localtime(reader.start_unix_ns / 1e9))
+    acks = {}
+    for ex in exchanges:
+        for tok in ex.replies:
+            if tok[0] == 'ACK':
+                acks[f"0x{tok[1]:02X}"] = acks.get(f"0x{tok[1]:02X}", 0) + 1
+    info = {
+        'trace': args.trace,
+        'recorded_at': start,
+        'duration_s': last_ns / 1e9,
+        'records': counts,
+        'bytes': sizes,
+        'exchanges': len(exchanges),
+        'acks': acks,
+    }
+    print(json.dumps(info, indent=2))
+    return 0
+
+
+def cmd_dump(args) -> int:
+    with TraceReader(args.trace) as reader:
+        for i, rec in enumerate(reader):
+            if args.limit is not None and i >= args.limit:
+                break
+            data = bytes(rec.data[:32]).hex(' ')
+            more = ' ...' if len(rec.data) > 32 else ''
+            print(f"{rec.t_ns / 1e6:>12.3f}ms {KIND_NAMES.get(rec.kind, '?'):<8}{len(rec.data):>6}  {data}{more}")
+    return 0
+
+
+def cmd_replay(args) -> int:
+    with TraceReader(args.trace) as reader:
+        exchanges = load_exchanges(reader)
+
+    if args.device:
+        import serial
+        from module.com.port_detector import PortDetector as pd
+        port = args.port or pd.find_arduino()
+        if port is None:
+            print("❌ 找不到 Arduino")
+            return 1
+        ser = serial.Serial(port, 115200, timeout=args.timeout)
+        time.sleep(2)  # 等待 Arduino 初始化
+    else:
+        from module.hid_emulator import EmulatedSerial
+        ser = EmulatedSerial(timeout=args.timeout)
+
+    try:
+        result = replay(ser, exchanges, 0 if args.max else args.speed)
+    finally:
+        ser.close()
+
+    if args.output:
+        with open(args.output, 'w', encoding='utf-8') as f:
+            json.dump(result, f, indent=2)
+    if args.json:
+        print(json.dumps(result, indent=2))
+    else:
+        print(f"exchanges={result['exchanges']} mismatches={result['mismatches']} timeouts={result['timeouts']}")
+        print(f"duration: original {result['original_duration_s']:.3f}s, replay {result['replay_duration_s']:.3f}s")
+        orig, rep = result['original_latency_us'], result['replay_latency_us']
+        print(f"first-reply latency p50/p99 (us): original {orig.get('p50', 0):.0f}/{orig.get('p99', 0):.0f}, "
+              f"replay {rep.get('p50', 0):.0f}/{rep.get('p99', 0):.0f}")
+        for m in result['first_mismatches']:
+            print(f"  #{m['index']} @{m['t_ms']:.1f}ms tx[{m['tx']}] expected {m['expected']} got {m['actual']}")
+    return 1 if result['mismatches'] else 0
+
+
+def build_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(description="Arduino HID trace inspection and replay")
+    sub = parser.add_subparsers(dest='command', required=True)
+
+    p = sub.add_parser('info', help="summary of a trace file")
+    p.add_argument('trace')
+    p.set_defaults(func=cmd_info)
+
+    p = sub.add_parser('dump', help="print trace records")
+    p.add_argument('trace')
+    p.add_argument('--limit', type=int, default=None)
+    p.set_defaults(func=cmd_dump)
+
+    p = sub.add_parser('replay', help="re-send a trace and diff ACK outcomes")
+    p.add_argument('trace')
+    p.add_argument('--speed', type=float, default=1.0, help="time scale (2 = twice as fast)")
+    p.add_argument('--max', action='store_true', help="as fast as ACKs allow")
+    p.add_argument('--device', action='store_true', help="replay to a real Arduino instead of the emulator")
+    p.add_argument('--port', default=None, help="COM port for --device (default: auto detect)")
+    p.add_argument('--timeout', type=float, default=0.1, help="per-read timeout (s)")
+    p.add_argument('--output', default=None, help="write JSON result to file")
+    p.add_argument('--json', action='store_true', help="print JSON result")
+    p.set_defaults(func=cmd_replay)
+    return parser
+
+
+def main(argv=None) -> int:
+    args = build_parser().parse_args(argv)
+    return args.func(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
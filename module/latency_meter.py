@@ -0,0 +1,227 @@
+"""
+端到端輸入到畫面延遲量測 (input-to-pixel)
+
+經由 ArduinoHID 送出已知動作 (例如切換 UI 的按鍵), 同時以持續的 CaptureSession
+輪詢視窗內一個區域, 量測從送出封包到區域內容改變的時間。每次動作都是切換,
+所以開 / 關兩個方向都會量到, 結果以百分位數回報。
+
+每次量測回報的延遲是上界 (看到變化那次截圖完成的時間), 解析度為
+上一次截圖開始到這次截圖完成的間隔, 兩者一起回報。
+
+Run:
+    python -m module.latency_meter --region 10 10 120 40 --key F12
+    python -m module.latency_meter --port COM5 --region 300 200 64 64 --key i --trials 200 --output latency.json
+"""
+import argparse
+import json
+import platform
+import random
+import sys
+import time
+from typing import Callable, Dict, List, Optional
+
+import numpy as np
+
+from module.arduino_hid import ArduinoHID, ArduinoHIDException
+from module.bench import percentiles
+from module.screenshot.window_capture import CaptureSession, WindowCapture, WindowCaptureException
+
+REGION_NAME = 'latency_probe'
+
+
+def changed_ratio(image: np.ndarray, reference: np.ndarray, tolerance: int) -> float:
+    """BGR 任一通道差異超過 tolerance 的像素比例 (忽略 alpha)"""
+    diff = np.abs(image[..., :3].astype(np.int16) - reference[..., :3])
+    return float((diff > tolerance).any(axis=2).mean())
+
+
+def wait_stable(probe: Callable[[], np.ndarray], tolerance: int, threshold: float,
+                frames: int, timeout: float) -> Optional[np.ndarray]:
+    """等待區域連續 frames 張不再變化, 回傳穩定後的影像 (逾時回傳 None)"""
+    reference = probe().astype(np.int16)
+    stable = 0
+    deadline = time.perf_counter() + timeout
+    while time.perf_counter() < deadline:
+        image = probe()
+        if changed_ratio(image, reference, tolerance) <= threshold:
+            stable += 1
+            if stable >= frames:
+                return reference
+        else:
+            stable = 0
+            reference = image.astype(np.int16)
+    return None
+
+
+def measure_once(probe: Callable[[], np.ndarray], action: Callable[[], bool], reference: np.ndarray,
+                 tolerance: int, threshold: float, timeout: float) -> Optional[dict]:
+    """
+    送出一次動作並輪詢到區域改變
+
+    Returns:
+        {'latency_ms', 'resolution_ms', 'ack_ms', 'polls'}; 逾時或送出失敗回傳 None
+    """
+    t_send = time.perf_counter()
+    if not action():
+        return None
+    t_ack = time.perf_counter()
+
+    prev_start = t_send
+    polls = 0
+    deadline = t_send + timeout
+    while True:
+        start = time.perf_counter()
+        image = probe()
+        end = time.perf_counter()
+        polls += 1
+        if changed_ratio(image, reference, tolerance) > threshold:
+            return {
+                'latency_ms': (end - t_send) * 1e3,
+                'resolution_ms': (end - prev_start) * 1e3,
+                'ack_ms': (t_ack - t_send) * 1e3,
+                'polls': polls,
+            }
+        if end >= deadline:
+            return None
+        prev_start = start
+
+
+def run_trials(probe: Callable[[], np.ndarray], press: Callable[[], bool], release: Callable[[], bool],
+               trials: int, tolerance: int = 16, threshold: float = 0.02, timeout: float = 1.0,
+               settle_frames: int = 3, settle_timeout: float = 2.0, gap: float = 0.1) -> dict:
+    """
+    重複量測 trials 次
+
+    Args:
+        probe: 回傳區域影像 ((h, w, 4) uint8 BGRA) 的函式
+        press: 觸發畫面變化的動作 (計時對象)
+        release: 觸發後執行的收尾動作 (例如放開按鍵), 不計時
+        tolerance: 單一像素視為改變的通道差異
+        threshold: 區域改變的像素比例門檻
+        timeout: 單次等待畫面改變的上限 (秒)
+        settle_frames: 每次量測前區域需連續不變的張數
+        gap: 兩次量測間隔的上限 (秒), 實際間隔隨機, 避免與螢幕更新同相
+    """
+    samples: List[dict] = []
+    timeouts = 0
+    unstable = 0
+    for i in range(trials):
+        reference = wait_stable(probe, tolerance, threshold, settle_frames, settle_timeout)
+        if reference is None:
+            unstable += 1
+            continue
+        time.sleep(random.uniform(0, gap))
+        result = measure_once(probe, press, reference, tolerance, threshold, timeout)
+        release()
+        if result is None:
+            timeouts += 1
+            continue
+        result['trial'] = i
+        samples.append(result)
+
+    def dist(key: str) -> Dict[str, float]:
+        return percentiles([s[key] for s in samples])
+
+    return {
+        'trials': trials,
+        'measured': len(samples),
+        'timeouts': timeouts,
+        'unstable': unstable,
+        'latency_ms': dist('latency_ms'),
+        'resolution_ms': dist('resolution_ms'),
+        'ack_ms': dist('ack_ms'),
+        'samples': samples,
+    }
+
+
+def parse_key(name: str) -> int:
+    """'F12' / 'ESC' / 'LEFT_SHIFT' 對應 ArduinoHID.KEY_*, 單一字元使用其 ASCII"""
+    if len(name) == 1:
+        return ord(name)
+    key = getattr(ArduinoHID, f"KEY_{name.upper()}", None)
+    if key is None:
+        raise argparse.ArgumentTypeError(f"unknown key: {name}")
+    return key
+
+
+def print_report(report: dict):
+    meta = report['meta']
+    print(f"window={meta['window']} region={meta['region']} action={meta['action']} "
+          f"frame={'V2' if meta.get('frame_v2') else 'V1'}")
+    print(f"trials={report['trials']} measured={report['measured']} "
+          f"timeouts={report['timeouts']} unstable={report['unstable']}")
+    print(f"{'(ms)':<14}{'p50':>9}{'p90':>9}{'p99':>9}{'min':>9}{'max':>9}{'mean':>9}")
+    for key in ('latency_ms', 'resolution_ms', 'ack_ms'):
+        d = report[key]
+        if not d:
+            continue
+        print(f"{key[:-3]:<14}{d['p50']:>9.2f}{d['p90']:>9.2f}{d['p99']:>9.2f}"
+              f"{d['min']:>9.2f}{d['max']:>9.2f}{d['mean']:>9.2f}")
+
+
+def build_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(description="End-to-end HID input to screen pixel latency meter")
+    parser.add_argument('--window', default="MapleStory", help="target window title")
+    parser.add_argument('--region', type=int, nargs=4, required=True, metavar=('LEFT', 'TOP', 'WIDTH', 'HEIGHT'),
+                        help="probe region relative to the window (logical pixels)")
+    action = parser.add_mutually_exclusive_group()
+    action.add_argument('--key', type=parse_key, default=None, help="key that toggles the region (e.g. F12, i)")
+    action.add_argument('--click', action='store_true', help="left click instead of a key")
+    parser.add_argument('--trials', type=int, default=100)
+    parser.add_argument('--tolerance', type=int, default=16, help="per-channel difference for a changed pixel")
+    parser.add_argument('--threshold', type=float, default=0.02, help="changed pixel ratio that counts as a transition")
+    parser.add_argument('--timeout', type=float, default=1.0, help="seconds to wait for each transition")
+    parser.add_argument('--gap', type=float, default=0.1, help="max random delay between trials (s)")
+    parser.add_argument('--scale', type=float, default=None, help="manual DPI scale (default: auto)")
+    parser.add_argument('--port', default=None, help="COM port (default: auto detect)")
+    parser.add_argument('--output', default=None, help="write JSON report to file")
+    parser.add_argument('--json', action='store_true', help="print JSON report")
+    return parser
+
+
+def main(argv=None) -> int:
+    args = build_parser().parse_args(argv)
+    if args.key is None and not args.click:
+        args.key = ArduinoHID.KEY_F12
+
+    capture = WindowCapture(args.window)
+    capture.add_region(REGION_NAME, *args.region)
+    try:
+        with ArduinoHID(port=args.port) as hid, CaptureSession(capture, args.scale) as session:
+            if args.click:
+                press, release = (lambda: hid.mouse_press(hid.MOUSE_LEFT)), (lambda: hid.mouse_release(hid.MOUSE_LEFT))
+            else:
+                press, release = (lambda: hid.keyboard_press(args.key)), (lambda: hid.keyboard_release(args.key))
+
+            hid.pause_logging()  # Serial1 日誌會拖慢韌體, 量測時先關閉
+            try:
+                report = run_trials(lambda: session.grab_regions()[REGION_NAME], press, release,
+                                    args.trials, args.tolerance, args.threshold, args.timeout, gap=args.gap)
+            finally:
+                hid.keyboard_release_all()
+                hid.resume_logging()
+            report['meta'] = {
+                'window': args.window,
+                'region': args.region,
+                'action': 'click' if args.click else f"key 0x{args.key:02X}",
+                'frame_v2': hid.frame_v2,
+                'python': platform.python_version(),
+                'platform': platform.platform(),
+                'time': time.strftime('%Y-%m-%dT%H:%M:%S'),
+            }
+    except (ArduinoHIDException, WindowCaptureException) as e:
+        print(f"❌ 錯誤: {e}")
+        return 1
+
+    if args.output:
+        with open(args.output, 'w', encoding='utf-8') as f:
+            json.dump(report, f, indent=2)
+    if args.json:
+        print(json.dumps(report, indent=2))
+    else:
+        print_report(report)
+    return 0 if report['measured'] else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,145 @@
+"""
+Arduino HID 鏈路自我測試
+
+用 CMD_ECHO 量測來回延遲 (RTT), 用 CMD_SINK 量測 USB CDC 持續頻寬,
+將鏈路本身的能力與韌體處理成本分開。
+
+Run:
+    python -m module.link_selftest
+    python -m module.link_selftest --port COM5 --echo-count 2000 --json
+"""
+import argparse
+import json
+import os
+import sys
+import time
+from typing import List, Optional, Sequence
+
+from module.arduino_hid import ArduinoHID, ArduinoHIDException
+from module.bench import percentiles
+
+
+def measure_echo(hid: ArduinoHID, payload_size: int, count: int) -> Optional[dict]:
+    """送出 count 次 echo, 回傳 RTT 統計 (微秒)"""
+    payload = os.urandom(payload_size)
+    rtts: List[float] = []
+    errors = 0
+
+    for _ in range(count):
+        start = time.perf_counter()
+        resp = hid.echo(payload)
+        elapsed = time.perf_counter() - start
+        if resp != payload:
+            errors += 1
+            continue
+        rtts.append(elapsed * 1e6)
+
+    if not rtts:
+        return None
+    return {
+        'payload': payload_size,
+        'count': count,
+        'errors': errors,
+        'rtt_us': percentiles(rtts),
+    }
+
+
+def measure_sink(hid: ArduinoHID, total_bytes: int) -> Optional[dict]:
+    """送出 total_bytes 原始資料, 回傳 Host / Arduino 兩端量到的頻寬"""
+    result = hid.sink(total_bytes)
+    if result is None:
+        return None
+
+    received = result['received']
+    device_s = result['device_us'] / 1e6
+    return {
+        'bytes': total_bytes,
+        'received': received,
+        'device_bytes_per_sec': received / device_s if device_s > 0 else None,
+        'host_bytes_per_sec': received / result['host_s'] if result['host_s'] > 0 else None,
+    }
+
+
+def run(hid: ArduinoHID, echo_sizes: Sequence[int], echo_count: int, sink_sizes: Sequence[int]) -> dict:
+    caps = hid.get_capabilities()
+    report = {'caps': caps, 'frame_v2': hid.frame_v2, 'echo': [], 'sink': []}
+    if caps is None or not (caps['features'] & ArduinoHID.FEATURE_LOOPBACK):
+        report['error'] = "firmware does not support CMD_ECHO / CMD_SINK"
+        return report
+
+    hid.pause_logging()  # Serial1 日誌會拖慢韌體, 量測時先關閉
+    try:
+        for size in echo_sizes:
+            size = min(size, hid.max_payload - 1)
+            report['echo'].append(measure_echo(hid, size, echo_count))
+        for total in sink_sizes:
+            report['sink'].append(measure_sink(hid, total))
+    finally:
+        hid.resume_logging()
+
+    # 量測完再查詢, high-water 才會包含 echo / sink 時的 stack 深度
+    if caps['features'] & ArduinoHID.FEATURE_MEMINFO:
+        report['memory'] = hid.get_meminfo()
+    return report
+
+
+def print_report(report: dict):
+    print(f"Frame format: {'V2' if report['frame_v2'] else 'V1'} | caps: {report['caps']}")
+    if 'error' in report:
+        print(f"❌ {report['error']}")
+        return
+
+    print("\n--- Echo RTT (us) ---")
+    print(f"{'payload':>8}{'p50':>10}{'p90':>10}{'p99':>10}{'p99.9':>10}{'max':>10}{'errors':>8}")
+    for r in report['echo']:
+        if r is None:
+            print(f"{'-':>8}  no response")
+            continue
+        rtt = r['rtt_us']
+        print(f"{r['payload']:>8}{rtt['p50']:>10.0f}{rtt['p90']:>10.0f}{rtt['p99']:>10.0f}"
+              f"{rtt['p999']:>10.0f}{rtt['max']:>10.0f}{r['errors']:>8}")
+
+    print("\n--- Sink throughput (bytes/sec) ---")
+    print(f"{'bytes':>10}{'received':>10}{'device':>14}{'host':>14}")
+    for r in report['sink']:
+        if r is None:
+            print(f"{'-':>10}  no response")
+            continue
+        device = f"{r['device_bytes_per_sec']:,.0f}" if r['device_bytes_per_sec'] else '-'
+        host = f"{r['host_bytes_per_sec']:,.0f}" if r['host_bytes_per_sec'] else '-'
+        print(f"{r['bytes']:>10}{r['received']:>10}{device:>14}{host:>14}")
+
+    mem = report.get('memory')
+    if mem:
+        print("\n--- SRAM (bytes) ---")
+        print(f"total {mem['ram']} | static {mem['static']} | free {mem['free']} | "
+              f"min free {mem['free_min']} | max stack {mem['stack_max']}")
+        for name, size in sorted(mem['structures'].items(), key=lambda kv: -kv[1]):
+            print(f"  {name:<14}{size:>6}")
+
+
+def main(argv=None) -> int:
+    parser = argparse.ArgumentParser(description="Arduino HID link self-test (echo RTT / sink throughput)")
+    parser.add_argument('--port', default=None, help="COM port (default: auto detect)")
+    parser.add_argument('--echo-count', type=int, default=500)
+    parser.add_argument('--echo-sizes', type=int, nargs='+', default=[1, 16, 64, 254])
+    parser.add_argument('--sink-sizes', type=int, nargs='+', default=[16 * 1024, 256 * 1024])
+    parser.add_argument('--json', action='store_true', help="print JSON report")
+    args = parser.parse_args(argv)
+
+    try:
+        with ArduinoHID(port=args.port) as hid:
+            report = run(hid, args.echo_sizes, args.echo_count, args.sink_sizes)
+    except ArduinoHIDException as e:
+        print(f"❌ 錯誤: {e}")
+        return 1
+
+    if args.json:
+        print(json.dumps(report, indent=2))
+    else:
+        print_report(report)
+    return 0 if 'error' not in report else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,9 +1,13 @@
 import os
 from pathlib import Path
+import atexit
 import datetime
 import logging
+import queue
 import sys
-from typing import Callable, List
+import time
+from logging.handlers import QueueHandler, QueueListener
+from typing import Callable, List, Optional
 
 from rich.console import Console, ConsoleOptions, ConsoleRenderable, NewLine
 from rich.highlighter import RegexHighlighter, NullHighlighter
@@ -79,6 +83,118 @@ class RichRenderableHandler(RichHandler):
         super().handle(record)
 
 
+class DroppingQueueHandler(QueueHandler):
+    """
+    Hand records to a bounded queue instead of formatting them on the caller thread.
+
+    Overflow policy when the listener falls behind:
+        drop_new:    discard the incoming record (default, never blocks)
+        drop_oldest: discard the oldest queued record to make room
+        block:       wait up to block_timeout, then discard
+    Dropped records are counted and reported by a warning once the queue drains.
+    """
+    POLICIES = ('drop_new', 'drop_oldest', 'block')
+
+    def __init__(self, q: queue.Queue, policy: str = 'drop_new', block_timeout: float = 0.05):
+        if policy not in self.POLICIES:
+            raise ValueError(f"Unknown overflow policy: {policy}")
+        super().__init__(q)
+        self.policy = policy
+        self.block_timeout = block_timeout
+        self.dropped = 0
+        self._unreported = 0
+
+    def prepare(self, record: logging.LogRecord):
+        # Only resolve the message (args may be mutated after the call returns);
+        # rich rendering and tracebacks are left to the listener thread.
+        record.msg = record.getMessage()
+        record.args = None
+        return record
+
+    def enqueue(self, record) -> None:
+        try:
+            self.queue.put_nowait(record)
+        except queue.Full:
+            self._overflow(record)
+            return
+        if self._unreported:
+            self._report_drops()
+
+    def _overflow(self, record) -> None:
+        if self.policy == 'drop_oldest':
+            if self._remove_oldest_record():
+                try:
+                    self.queue.put_nowait(record)
+                except queue.Full:
+                    pass
+        elif self.policy == 'block':
+            try:
+                self.queue.put(record, timeout=self.block_timeout)
+                return
+            except queue.Full:
+                pass
+        self.dropped += 1
+        self._unreported += 1
+
+    def _remove_oldest_record(self) -> bool:
+        """ Remove the oldest queued LogRecord; callables from submit() and the stop sentinel are kept. """
+        q = self.queue
+        with q.mutex:
+            for i, item in enumerate(q.queue):
+                if isinstance(item, logging.LogRecord):
+                    del q.queue[i]
+                    break
+            else:
+                return False
+            # Same bookkeeping as get() + task_done() for the removed item
+            q.unfinished_tasks -= 1
+            if q.unfinished_tasks == 0:
+                q.all_tasks_done.notify_all()
+            q.not_full.notify()
+        return True
+
+    def _report_drops(self) -> None:
+        count, self._unreported = self._unreported, 0
+        record = logging.makeLogRecord({
+            'name': logger.name, 'levelno': logging.WARNING, 'levelname': 'WARNING',
+            'msg': f'Log queue full, dropped {count} records'})
+        try:
+            self.queue.put_nowait(record)
+        except queue.Full:
+            self._unreported += count
+
+    def submit(self, func: Callable[[], None], block: bool = False) -> None:
+        """
+        Run func on the listener thread, in order with the queued records.
+        block=True waits for room instead of applying the overflow policy.
+        """
+        if block:
+            self.queue.put(func)
+        else:
+            self.enqueue(func)
+
+
+class LogListener(QueueListener):
+    """
+    Background thread that formats and writes queued records.
+    Besides LogRecord, also runs callables queued by DroppingQueueHandler.submit().
+    """
+
+    def handle(self, record) -> None:
+        try:
+            if callable(record):
+                record()
+            else:
+                super().handle(record)
+        except Exception:
+            # An exception here would end the listener thread silently
+            sys.stderr.write(f"Log listener error on {record!r}\n")
+
+    def enqueue_sentinel(self) -> None:
+        # Must not be dropped by a full queue, or stop() would hang
+        self.queue.put(self._sentinel)
+
+
 class HTMLConsole(Console):
     """
     Force full feature console
@@ -131,6 +247,8 @@ CONSOLE_THEME = Theme({
 
 # Logger init
 logger_debug = False
+logger_async = True  # Format and write records on a background thread
+logger_queue_size = 10000
 logger = logging.getLogger("msfk")
 logger.setLevel(logging.DEBUG if logger_debug else logging.INFO)
 file_formatter = logging.Formatter(
@@ -162,6 +280,86 @@ PROJECT_ROOT = Path(__file__).parent.parent
 LOG_DIR = PROJECT_ROOT / "log"
 LOG_DIR.mkdir(exist_ok=True)
 
+# Queued logging, see set_async()
+_queue_handler: Optional[DroppingQueueHandler] = None
+_listener: Optional[LogListener] = None
+
+
+def _get_sinks() -> List[logging.Handler]:
+    """ Handlers that actually write records (owned by the listener while async). """
+    return list(_listener.handlers) if _listener else list(logger.handlers)
+
+
+def _set_sinks(handlers: List[logging.Handler]) -> None:
+    if _listener:
+        _listener.handlers = tuple(handlers)
+    else:
+        logger.handlers = handlers
+
+
+def _replace_sink(types, handler: logging.Handler) -> None:
+    """ Swap the sinks of the given types for handler, after the records already queued. """
+    def apply():
+        _set_sinks([h for h in _get_sinks() if not isinstance(h, types)] + [handler])
+
+    if _queue_handler is not None:
+        _queue_handler.submit(apply, block=True)
+    else:
+        apply()
+
+
+def set_async(enabled: bool = True, capacity: int = logger_queue_size, policy: str = 'drop_new') -> None:
+    """
+    Move the current handlers behind a bounded queue and a listener thread.
+    The caller only pays for the level check, message resolution and a queue put.
+
+    Args:
+        enabled: False flushes the queue and puts the handlers back on the logger
+        capacity: Queue size before the overflow policy applies
+        policy: See DroppingQueueHandler
+    """
+    global _queue_handler, _listener
+    if enabled == (_listener is not None):
+        return
+    if enabled:
+        q = queue.Queue(capacity)
+        sinks = list(logger.handlers)
+        _queue_handler = DroppingQueueHandler(q, policy)
+        _listener = LogListener(q, *sinks, respect_handler_level=True)
+        _listener.start()
+        logger.handlers = [_queue_handler]
+    else:
+        # Drain the queue before the sinks go back on the logger, so new records cannot overtake queued ones
+        listener = _listener
+        listener.stop()
+        _listener, _queue_handler = None, None
+        logger.handlers = list(listener.handlers)
+        # Records (or sink swaps) queued between the stop sentinel and the handler swap
+        while True:
+            try:
+                listener.handle(listener.queue.get_nowait())
+            except queue.Empty:
+                break
+
+
+def flush_logs() -> None:
+    """ Block until every queued record has been written. """
+    if _queue_handler is not None:
+        _queue_handler.queue.join()
+
+
+def log_stats() -> dict:
+    if _queue_handler is None:
+        return {'async': False}
+    return {
+        'async': True,
+        'policy': _queue_handler.policy,
+        'queued': _queue_handler.queue.qsize(),
+        'capacity': _queue_handler.queue.maxsize,
+        'dropped': _queue_handler.dropped,
+    }
+
+
 # Add file logger
 pyw_name = os.path.splitext(os.path.basename(sys.argv[0]))[0]
 
@@ -177,9 +375,7 @@ def _set_file_logger(name=pyw_name):
         file = logging.FileHandler(log_file, encoding='utf-8')
     file.setFormatter(file_formatter)
 
-    logger.handlers = [h for h in logger.handlers if not isinstance(
-        h, (logging.FileHandler, RichFileHandler))]
-    logger.addHandler(file)
+    _replace_sink((logging.FileHandler, RichFileHandler), file)
     logger.log_file = log_file
 
 
@@ -213,9 +409,7 @@ def set_file_logger(name=pyw_name):
     )
     hdlr.setFormatter(file_formatter)
 
-    logger.handlers = [h for h in logger.handlers if not isinstance(
-        h, (logging.FileHandler, RichFileHandler))]
-    logger.addHandler(hdlr)
+    _replace_sink((logging.FileHandler, RichFileHandler), hdlr)
     logger.log_file = log_file
 
 
@@ -242,9 +436,7 @@ def set_func_logger(func):
         highlighter=Highlighter(),
     )
     hdlr.setFormatter(web_formatter)
-    logger.handlers = [h for h in logger.handlers if not isinstance(
-        h, RichRenderableHandler)]
-    logger.addHandler(hdlr)
+    _replace_sink(RichRenderableHandler, hdlr)
 
 
 def _get_renderables(
@@ -273,7 +465,15 @@ def _get_renderables(
 
 
 def print(*objects: ConsoleRenderable, **kwargs):
-    for hdlr in logger.handlers:
+    if _queue_handler is not None:
+        # Keep rules in order with the records queued before them
+        _queue_handler.submit(lambda: _print(*objects, **kwargs))
+    else:
+        _print(*objects, **kwargs)
+
+
+def _print(*objects: ConsoleRenderable, **kwargs):
+    for hdlr in _get_sinks():
         if isinstance(hdlr, RichRenderableHandler):
             for renderable in _get_renderables(hdlr.console, *objects, **kwargs):
                 hdlr._func(renderable)
@@ -353,9 +553,64 @@ logger.print = print
 logger.log_file: str
 
 logger.set_file_logger()
+logger.set_async = set_async
+logger.flush = flush_logs
+logger.log_stats = log_stats
+if logger_async:
+    set_async(True)
+    atexit.register(set_async, False)  # Runs before logging.shutdown(), drains the queue
 logger.hr('Start', level=0)
 
 
+def measure_caller_cost(count: int = 2000) -> dict:
+    """
+    Caller-side cost (us) of one logger.info() with the same rich console + file
+    handlers, synchronous vs queued. Sinks write to os.devnull.
+    """
+    devnull = open(os.devnull, 'w', encoding='utf-8')
+    console_sink = RichHandler(console=Console(file=devnull, width=119), show_path=False, show_time=False)
+    console_sink.setFormatter(console_formatter)
+    file_sink = RichFileHandler(console=Console(file=devnull, no_color=True, highlight=False, width=119),
+                                show_path=False, show_time=False, show_level=False,
+                                highlighter=NullHighlighter())
+    file_sink.setFormatter(file_formatter)
+
+    bench = logging.getLogger("msfk.caller_cost")
+    bench.propagate = False
+    bench.setLevel(logging.INFO)
+
+    def run() -> dict:
+        samples = []
+        for i in range(count):
+            start = time.perf_counter()
+            bench.info(f'Capture geometry: window=(0, 0, 1366, 768) scale=1.25 frame {i}')
+            samples.append((time.perf_counter() - start) * 1e6)
+        samples.sort()
+        return {
+            'p50': samples[len(samples) // 2],
+            'p99': samples[min(len(samples) - 1, int(len(samples) * 0.99))],
+            'max': samples[-1],
+            'mean': sum(samples) / len(samples),
+        }
+
+    bench.handlers = [console_sink, file_sink]
+    result = {'sync': run()}
+
+    q = queue.Queue(logger_queue_size)
+    handler = DroppingQueueHandler(q)
+    listener = LogListener(q, console_sink, file_sink, respect_handler_level=True)
+    listener.start()
+    bench.handlers = [handler]
+    result['queued'] = run()
+    q.join()
+    listener.stop()
+    result['queued']['dropped'] = handler.dropped
+
+    bench.handlers = []
+    devnull.close()
+    return result
+
+
 def set_debug(enabled: bool):
     logger.setLevel(logging.DEBUG if enabled else logging.INFO)
     logger.info(f"🔧 Debug mode: {'ON' if enabled else 'OFF'}")
@@ -387,3 +642,7 @@ if __name__ == "__main__":
     logger.set_debug(False)
 
     logger.debug("被遮蔽!")
+
+    for mode, stats in measure_caller_cost().items():
+        logger.info(f"logger.info() caller cost ({mode}): " + ', '.join(
+            f"{k}={v:.1f}us" if isinstance(v, float) else f"{k}={v}" for k, v in stats.items()))
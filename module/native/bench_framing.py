@@ -0,0 +1,92 @@
+"""
+封包組裝基準測試: 純 Python vs 原生擴充模組 (frames/sec)
+
+Run:
+    python module/native/setup.py build_ext --inplace
+    python -m module.native.bench_framing
+"""
+import argparse
+import json
+import sys
+import time
+
+from module import hid_frame
+
+CMD_MOUSE_MOVE = 0x01
+CMD_KB_PRINT = 0x14
+
+
+def _legacy_frame(cmd: int, params: bytes) -> bytes:
+    """舊版 ArduinoHID._send_packet 的組裝方式 (多次 bytes 串接)"""
+    data = bytes([cmd]) + params
+    crc = hid_frame.py_crc8(data)
+    return bytes([hid_frame.SYNC_BYTE, len(data)]) + data + bytes([crc])
+
+
+def _run(fn, frames: int) -> float:
+    start = time.perf_counter()
+    fn()
+    elapsed = time.perf_counter() - start
+    return frames / elapsed if elapsed > 0 else float('inf')
+
+
+def bench_case(name: str, params: bytes, v2: bool, frames: int, batch: int) -> dict:
+    commands = [(CMD_MOUSE_MOVE if len(params) == 3 else CMD_KB_PRINT, params)] * batch
+    rounds = max(1, frames // batch)
+    total = rounds * batch
+    result = {'case': name, 'v2': v2, 'payload': len(params), 'frames': total}
+
+    if not v2:
+        def legacy():
+            for _ in range(rounds):
+                b''.join(_legacy_frame(cmd, p) for cmd, p in commands)
+        result['legacy_concat'] = _run(legacy, total)
+
+    builders = [('python', hid_frame.PyFrameBuilder)]
+    if hid_frame.NATIVE:
+        builders.append(('native', hid_frame._hidframe.FrameBuilder))
+
+    for label, cls in builders:
+        builder = cls(v2=v2, capacity=batch * hid_frame.frame_size(len(params) + 1, v2))
+
+        def build():
+            for _ in range(rounds):
+                builder.clear()
+                builder.extend(commands)
+                builder.getbuffer()
+        result[label] = _run(build, total)
+
+    return result
+
+
+def main(argv=None) -> int:
+    parser = argparse.ArgumentParser(description="HID framing benchmark (frames/sec)")
+    parser.add_argument('--frames', type=int, default=200000, help="frames per case")
+    parser.add_argument('--batch', type=int, default=16, help="frames per write()")
+    parser.add_argument('--json', action='store_true', help="print JSON only")
+    args = parser.parse_args(argv)
+
+    cases = [
+        ('mouse_move', bytes(3), False),
+        ('mouse_move', bytes(3), True),
+        ('kb_print_30', b'x' * 30, False),
+        ('kb_print_254', b'x' * 254, True),
+    ]
+    results = [bench_case(name, params, v2, args.frames, args.batch) for name, params, v2 in cases]
+
+    if args.json:
+        print(json.dumps({'native': hid_frame.NATIVE, 'results': results}, indent=2))
+        return 0
+
+    print(f"native module: {'yes' if hid_frame.NATIVE else 'no (pure Python fallback)'}")
+    print(f"{'case':<14}{'fmt':<5}{'legacy':>14}{'python':>14}{'native':>14}  (frames/sec)")
+    for r in results:
+        fmt = 'V2' if r['v2'] else 'V1'
+        cols = [r.get(k) for k in ('legacy_concat', 'python', 'native')]
+        cells = ''.join(f"{c:>14,.0f}" if c else f"{'-':>14}" for c in cols)
+        print(f"{r['case']:<14}{fmt:<5}{cells}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,25 @@
+"""
+編譯 HID 原生擴充模組
+
+Run:
+    python module/native/setup.py build_ext --inplace
+"""
+import os
+import sys
+
+from setuptools import Extension, setup
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+if __name__ == "__main__":
+    # 讓 --inplace 輸出到 module/native/ 底下
+    os.chdir(HERE)
+    if len(sys.argv) == 1:
+        sys.argv += ["build_ext", "--inplace"]
+
+    setup(
+        name="hidframe",
+        ext_modules=[
+            Extension("_hidframe", sources=["_hidframe.c"], extra_compile_args=["-O2"] if os.name != "nt" else ["/O2"]),
+        ],
+    )
@@ -0,0 +1,371 @@
+"""
+滑鼠指標閉迴路校正
+
+CMD_MOUSE_MOVE 是相對移動, 作業系統又會套用指標加速, 所以同樣的 report 數值
+在不同速度 / 螢幕 / DPI 縮放下移動的像素不同。本工具經由 ArduinoHID.mouse_move
+送出已知的單一 report, 以 WindowCapture 讀取游標位置, 為每個軸擬合
+「report 數值 -> 像素」的單調曲線, 依螢幕與 DPI 縮放存成設定檔。
+之後的移動用反函數規劃 report 序列, 一次送出就落在目標附近。
+
+兩軸分開擬合; Windows 的加速依每個 report 的位移量計算, 所以規劃時
+每個 report 各自對應曲線上的一點。
+
+Run:
+    python -m module.pointer_calibration calibrate
+    python -m module.pointer_calibration verify --moves 50
+    python -m module.pointer_calibration drag --simulate
+    python -m module.pointer_calibration calibrate --simulate
+"""
+import argparse
+import json
+import random
+import sys
+import time
+from dataclasses import dataclass, field
+from pathlib import Path
+from typing import Callable, Dict, List, Optional, Sequence, Tuple
+
+import numpy as np
+
+from module.arduino_hid import ArduinoHID, ArduinoHIDException
+from module.hid_emulator import EmulatedSerial
+
+PROFILE_PATH = Path(__file__).parent.parent / "asset" / "pointer_profile.json"
+DEFAULT_COUNTS = (1, 2, 3, 4, 6, 8, 12, 16, 24, 32, 48, 64, 96, 127)
+MAX_COUNT = 127
+
+CursorReader = Callable[[], Tuple[int, int]]
+
+
+@dataclass
+class AxisCurve:
+    """單軸的 report 數值 -> 像素曲線 (正方向; 負方向對稱)"""
+    counts: List[int]
+    pixels: List[float]
+
+    def to_pixels(self, count: int) -> float:
+        sign = -1 if count < 0 else 1
+        return sign * float(np.interp(abs(count), [0] + self.counts, [0.0] + self.pixels))
+
+    def to_count(self, pixels: float) -> int:
+        """最接近 pixels 的單一 report 數值 (上限 MAX_COUNT)"""
+        sign = -1 if pixels < 0 else 1
+        count = float(np.interp(abs(pixels), [0.0] + self.pixels, [0] + self.counts))
+        return sign * min(MAX_COUNT, int(round(count)))
+
+    def plan(self, pixels: float) -> List[int]:
+        """把位移拆成 report 序列: 先用最大的 report, 最後一個補足剩餘"""
+        reports = []
+        remaining = pixels
+        step = self.to_pixels(MAX_COUNT)
+        while abs(remaining) > step:
+            reports.append(MAX_COUNT if remaining > 0 else -MAX_COUNT)
+            remaining -= step if remaining > 0 else -step
+        last = self.to_count(remaining)
+        if last:
+            reports.append(last)
+        return reports
+
+
+@dataclass
+class PointerProfile:
+    monitor: str
+    scale: float
+    x: AxisCurve
+    y: AxisCurve
+    created: str = field(default_factory=lambda: time.strftime('%Y-%m-%dT%H:%M:%S'))
+
+    @property
+    def key(self) -> str:
+        return profile_key(self.monitor, self.scale)
+
+    def plan(self, dx: float, dy: float) -> List[Tuple[int, int]]:
+        """像素位移 -> [(x, y), ...] report 序列"""
+        xs, ys = self.x.plan(dx), self.y.plan(dy)
+        length = max(len(xs), len(ys))
+        xs += [0] * (length - len(xs))
+        ys += [0] * (length - len(ys))
+        return list(zip(xs, ys))
+
+    def to_dict(self) -> dict:
+        return {
+            'monitor': self.monitor, 'scale': self.scale, 'created': self.created,
+            'x': {'counts': self.x.counts, 'pixels': self.x.pixels},
+            'y': {'counts': self.y.counts, 'pixels': self.y.pixels},
+        }
+
+    @classmethod
+    def from_dict(cls, d: dict) -> "PointerProfile":
+        return cls(d['monitor'], d['scale'], AxisCurve(**d['x']), AxisCurve(**d['y']), d.get('created', ''))
+
+
+def profile_key(monitor: str, scale: float) -> str:
+    return f"{monitor}@{scale:.2f}"
+
+
+def load_profiles(path: Path = PROFILE_PATH) -> Dict[str, PointerProfile]:
+    if not Path(path).exists():
+        return {}
+    with open(path, encoding='utf-8') as f:
+        return {key: PointerProfile.from_dict(d) for key, d in json.load(f).items()}
+
+
+def save_profile(profile: PointerProfile, path: Path = PROFILE_PATH) -> None:
+    """寫入 / 覆寫同一螢幕與縮放的設定"""
+    profiles = load_profiles(path)
+    profiles[profile.key] = profile
+    Path(path).parent.mkdir(parents=True, exist_ok=True)
+    with open(path, 'w', encoding='utf-8') as f:
+        json.dump({key: p.to_dict() for key, p in profiles.items()}, f, indent=2)
+
+
+# ========== 量測 ==========
+
+def wait_settled(read_cursor: CursorReader, start: Tuple[int, int], settle: float, timeout: float) -> Tuple[int, int]:
+    """等游標離開 start 且 settle 秒內不再移動 (逾時回傳最後位置)"""
+    deadline = time.perf_counter() + timeout
+    last = start
+    last_change = None
+    while time.perf_counter() < deadline:
+        pos = read_cursor()
+        now = time.perf_counter()
+        if pos != last:
+            last, last_change = pos, now
+        elif last_change is not None and now - last_change >= settle:
+            break
+        time.sleep(0.001)
+    return last
+
+
+def measure_step(hid: ArduinoHID, read_cursor: CursorReader, dx: int, dy: int,
+                 settle: float = 0.03, timeout: float = 0.3) -> Tuple[int, int]:
+    """送出單一 report, 回傳游標實際移動的像素"""
+    start = read_cursor()
+    hid.mouse_move(dx, dy)
+    end = wait_settled(read_cursor, start, settle, timeout)
+    return end[0] - start[0], end[1] - start[1]
+
+
+def calibrate_axis(hid: ArduinoHID, read_cursor: CursorReader, axis: int,
+                   counts: Sequence[int] = DEFAULT_COUNTS, repeats: int = 3) -> Tuple[AxisCurve, List[dict]]:
+    """
+    量測單軸曲線; 每個數值正反各送 repeats 次, 游標來回擺動不會累積到螢幕邊緣
+
+    Args:
+        axis: 0 = x, 1 = y
+
+    Returns:
+        (AxisCurve, 原始樣本)
+    """
+    samples = []
+    pixels = []
+    for count in counts:
+        moved = []
+        for _ in range(repeats):
+            for sign in (1, -1):
+                delta = (sign * count, 0) if axis == 0 else (0, sign * count)
+                result = measure_step(hid, read_cursor, *delta)
+                distance = result[axis] * sign
+                samples.append({'axis': 'xy'[axis], 'count': sign * count, 'pixels': result[axis]})
+                if distance > 0:  # 0 表示卡在螢幕邊緣或沒量到, 不納入
+                    moved.append(distance)
+        pixels.append(float(np.median(moved)) if moved else 0.0)
+
+    # 加速曲線必定單調遞增, 雜訊造成的下降以前一點取代
+    pixels = np.maximum.accumulate(np.array(pixels)).tolist()
+    return AxisCurve(list(counts), pixels), samples
+
+
+def calibrate(hid: ArduinoHID, read_cursor: CursorReader, monitor: str, scale: float,
+              counts: Sequence[int] = DEFAULT_COUNTS, repeats: int = 3) -> Tuple[PointerProfile, List[dict]]:
+    hid.pause_logging()  # Serial1 日誌會拖慢韌體, 量測時先關閉
+    try:
+        x, x_samples = calibrate_axis(hid, read_cursor, 0, counts, repeats)
+        y, y_samples = calibrate_axis(hid, read_cursor, 1, counts, repeats)
+    finally:
+        hid.resume_logging()
+    return PointerProfile(monitor, scale, x, y), x_samples + y_samples
+
+
+def move_by(hid: ArduinoHID, profile: PointerProfile, dx: float, dy: float) -> int:
+    """依設定檔一次送出整段 report 序列, 回傳 report 數"""
+    reports = profile.plan(dx, dy)
+    if reports:
+        hid.send_batch([(hid.CMD_MOUSE_MOVE, bytes([x & 0xFF, y & 0xFF, 0])) for x, y in reports])
+    return len(reports)
+
+
+def move_to(hid: ArduinoHID, profile: Optional[PointerProfile], read_cursor: CursorReader,
+            target: Tuple[int, int], tolerance: int = 1, max_corrections: int = 5,
+            settle: float = 0.03) -> int:
+    """
+    閉迴路移動到 target; profile 為 None 時以 1 report = 1 像素估算 (校正前的行為)
+
+    Returns:
+        修正次數 (0 = 一次到位); 超過 max_corrections 回傳 -1
+    """
+    linear = PointerProfile('', 1.0, AxisCurve([1, MAX_COUNT], [1.0, float(MAX_COUNT)]),
+                            AxisCurve([1, MAX_COUNT], [1.0, float(MAX_COUNT)]))
+    profile = profile or linear
+    pos = read_cursor()
+    moves = 0
+    while True:
+        dx, dy = target[0] - pos[0], target[1] - pos[1]
+        if abs(dx) <= tolerance and abs(dy) <= tolerance:
+            return max(0, moves - 1)
+        if moves > max_corrections:
+            return -1
+        move_by(hid, profile, dx, dy)
+        moves += 1
+        pos = wait_settled(read_cursor, pos, settle, 0.5)
+
+
+def verify(hid: ArduinoHID, profile: Optional[PointerProfile], read_cursor: CursorReader,
+           moves: int, max_distance: int = 400, seed: int = 1) -> dict:
+    """隨機往返移動, 統計一次到位比例與修正次數"""
+    rng = random.Random(seed)
+    corrections = []
+    origin = read_cursor()
+    for _ in range(moves):
+        target = (origin[0] + rng.randint(-max_distance, max_distance),
+                  origin[1] + rng.randint(-max_distance // 2, max_distance // 2))
+        corrections.append(move_to(hid, profile, read_cursor, target))
+    landed = [c for c in corrections if c >= 0]
+    return {
+        'moves': moves,
+        'one_shot': sum(1 for c in corrections if c == 0) / moves if moves else 0.0,
+        'avg_corrections': sum(landed) / len(landed) if landed else None,
+        'failed': moves - len(landed),
+    }
+
+
+def _sign(v: int) -> int:
+    return (v > 0) - (v < 0)
+
+
+def verify_drag(hid: ArduinoHID, read_cursor: CursorReader, distance: int = 200,
+                duration_ms: int = 100, settle: float = 0.03) -> dict:
+    """
+    往 8 個方向 mouse_drag 再拖回原處, 檢查游標是否往指定方向移動
+
+    負位移 (往左/往上) 在韌體上走有號數插值, 方向錯誤時游標會先衝到相反的螢幕邊緣。
+    """
+    wrong = []
+    for dx, dy in ((1, 0), (1, 1), (0, 1), (-1, 1), (-1, 0), (-1, -1), (0, -1), (1, -1)):
+        dx, dy = dx * distance, dy * distance
+        start = read_cursor()
+        for sign in (1, -1):
+            hid.mouse_drag(sign * dx, sign * dy, duration_ms=duration_ms, press_settle_ms=0, release_settle_ms=0)
+            end = wait_settled(read_cursor, start, settle, 1.0 + duration_ms / 1000)
+            moved = (end[0] - start[0], end[1] - start[1])
+            if [_sign(m) for m in moved] != [_sign(sign * dx), _sign(sign * dy)]:
+                wrong.append((sign * dx, sign * dy, moved))
+            start = end
+    return {'drags': 16, 'wrong_direction': len(wrong), 'failures': wrong}
+
+
+# ========== 模擬 ==========
+
+class SimulatedPointerSerial(EmulatedSerial):
+    """
+    在模擬器上加一個有加速曲線的虛擬游標, 不接裝置也能跑校正流程
+
+    加速模型: 像素 = count * gain * (1 + accel * min(|count|, 20) / 20), 再四捨五入 (保留小數餘數)
+    """
+
+    def __init__(self, gain: float = 1.25, accel: float = 1.0, screen: Tuple[int, int] = (1920, 1080), **kwargs):
+        super().__init__(**kwargs)
+        self.gain = gain
+        self.accel = accel
+        self.screen = screen
+        self.cursor = [screen[0] / 2, screen[1] / 2]
+
+    def _axis(self, count: int) -> float:
+        return count * self.gain * (1 + self.accel * min(abs(count), 20) / 20)
+
+    def _pointer_move(self, dx: int, dy: int):
+        self.cursor[0] = min(self.screen[0] - 1, max(0.0, self.cursor[0] + self._axis(dx)))
+        self.cursor[1] = min(self.screen[1] - 1, max(0.0, self.cursor[1] + self._axis(dy)))
+
+    def read_cursor(self) -> Tuple[int, int]:
+        self._drain(self.clock())  # 讓已到期的指令執行
+        return int(self.cursor[0]), int(self.cursor[1])
+
+
+# ========== CLI ==========
+
+def open_target(args) -> Tuple[ArduinoHID, CursorReader, str, float]:
+    """回傳 (hid, 讀取游標的函式, 螢幕名稱, 縮放)"""
+    if args.simulate:
+        ser = SimulatedPointerSerial()
+        return ArduinoHID(ser=ser), ser.read_cursor, 'simulated', 1.0
+
+    from module.screenshot.window_capture import WindowCapture
+    capture = WindowCapture(args.window)
+    monitor = capture.get_cursor_monitor()
+    hid = ArduinoHID(port=args.port)
+    if monitor is None:
+        return hid, capture.get_cursor_position, 'unknown', 1.0
+    return hid, capture.get_cursor_position, monitor.name, monitor.scale_factor
+
+
+def main(argv=None) -> int:
+    parser = argparse.ArgumentParser(description="Closed-loop pointer calibration (HID counts -> screen pixels)")
+    parser.add_argument('command', choices=('calibrate', 'verify', 'drag'))
+    parser.add_argument('--port', default=None, help="COM port (default: auto detect)")
+    parser.add_argument('--window', default="MapleStory", help="window used for DPI / monitor lookup")
+    parser.add_argument('--profile', type=Path, default=PROFILE_PATH)
+    parser.add_argument('--repeats', type=int, default=3)
+    parser.add_argument('--moves', type=int, default=30, help="verify: random moves")
+    parser.add_argument('--simulate', action='store_true', help="use a simulated accelerated pointer")
+    parser.add_argument('--json', action='store_true', help="print JSON report")
+    args = parser.parse_args(argv)
+
+    try:
+        hid, read_cursor, monitor, scale = open_target(args)
+        with hid:
+            if args.command == 'drag':
+                report = {'drag': verify_drag(hid, read_cursor)}
+            elif args.command == 'calibrate':
+                profile, samples = calibrate(hid, read_cursor, monitor, scale, repeats=args.repeats)
+                if not args.simulate:
+                    save_profile(profile, args.profile)
+                report = {'profile': profile.to_dict(), 'samples': len(samples),
+                          'calibrated': verify(hid, profile, read_cursor, args.moves),
+                          'uncalibrated': verify(hid, None, read_cursor, args.moves)}
+            else:
+                profile = load_profiles(args.profile).get(profile_key(monitor, scale))
+                if profile is None:
+                    print(f"❌ 沒有 {profile_key(monitor, scale)} 的校正資料, 請先執行 calibrate")
+                    return 1
+                report = {'profile': profile.key,
+                          'calibrated': verify(hid, profile, read_cursor, args.moves),
+                          'uncalibrated': verify(hid, None, read_cursor, args.moves)}
+    except ArduinoHIDException as e:
+        print(f"❌ 錯誤: {e}")
+        return 1
+
+    if args.json:
+        print(json.dumps(report, indent=2))
+        return 0
+    if 'drag' in report:
+        drag = report['drag']
+        print(f"drag: {drag['drags'] - drag['wrong_direction']}/{drag['drags']} moved the right way")
+        for dx, dy, moved in drag['failures']:
+            print(f"  ❌ drag ({dx}, {dy}) moved the cursor by {moved}")
+        return 1 if drag['wrong_direction'] else 0
+    if 'samples' in report:
+        p = report['profile']
+        print(f"Profile {profile.key} ({report['samples']} samples)")
+        print(f"{'count':>6}{'x px':>9}{'y px':>9}")
+        for count, x, y in zip(p['x']['counts'], p['x']['pixels'], p['y']['pixels']):
+            print(f"{count:>6}{x:>9.1f}{y:>9.1f}")
+    else:
+        print(f"Profile {report['profile']}")
+    print(f"calibrated:   {report['calibrated']}")
+    print(f"uncalibrated: {report['uncalibrated']}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
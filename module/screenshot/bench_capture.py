@@ -0,0 +1,381 @@
+import argparse
+import json
+import os
+import platform
+import sys
+import tempfile
+import time
+import tracemalloc
+from dataclasses import dataclass
+from typing import Callable, Dict, List, Optional, Tuple
+
+import mss
+import mss.tools
+import numpy as np
+
+from module.bench import percentiles
+from module.logger import logger
+from module.screenshot.capture_stream import CaptureStream
+from module.screenshot.pixel_convert import FORMATS, PixelConverter, as_bgra
+from module.screenshot.window_capture import CaptureSession, WindowCapture, WindowCaptureException
+
+MODES = ('raw', 'array', 'png', 'gray', 'bgra/2', 'bgra/4', 'gray/2', 'gray/4', 'regions', 'stream')
+
+
+# ==================== Synthetic source ====================
+@dataclass
+class SyntheticShot:
+    """ The parts of mss.ScreenShot the capture path uses. """
+    raw: bytearray
+    pos: Tuple[int, int]
+    size: Tuple[int, int]
+
+    @property
+    def width(self) -> int:
+        return self.size[0]
+
+    @property
+    def height(self) -> int:
+        return self.size[1]
+
+    @property
+    def rgb(self) -> bytes:
+        # Same bytearray slicing as mss.ScreenShot.rgb, so the convert stage costs the same
+        rgb = bytearray(self.width * self.height * 3)
+        raw = self.raw
+        rgb[0::3], rgb[1::3], rgb[2::3] = raw[2::4], raw[1::4], raw[0::4]
+        return bytes(rgb)
+
+
+class SyntheticGrabber:
+    """
+    mss-compatible grabber over an in-memory screen: a fixed noisy gradient
+    with a block that moves every frame, so diffs and PNG sizes look like
+    real content. Allocates a new buffer per grab, as mss does.
+    """
+
+    def __init__(self, width: int = 1920, height: int = 1080, block: int = 64, seed: int = 1):
+        rng = np.random.default_rng(seed)
+        ys, xs = np.mgrid[0:height, 0:width]
+        screen = np.empty((height, width, 4), dtype=np.uint8)
+        screen[..., 0] = xs * 255 // max(1, width - 1)
+        screen[..., 1] = ys * 255 // max(1, height - 1)
+        screen[..., 2] = rng.integers(0, 32, (height, width), dtype=np.uint8) + 96
+        screen[..., 3] = 255
+        self.screen = screen
+        self.block = block
+        self.frames = 0
+        self.monitors = [{'left': 0, 'top': 0, 'width': width, 'height': height}] * 2
+
+    def grab(self, monitor: Dict[str, int]) -> SyntheticShot:
+        left, top = monitor['left'], monitor['top']
+        width, height = monitor['width'], monitor['height']
+        self.frames += 1
+        data = bytearray(width * height * 4)
+        view = np.frombuffer(data, dtype=np.uint8).reshape(height, width, 4)
+        view[:] = self.screen[top:top + height, left:left + width]
+
+        # Moving block, in monitor coordinates
+        span_x, span_y = max(1, width - self.block), max(1, height - self.block)
+        x, y = (self.frames * 7) % span_x, (self.frames * 3) % span_y
+        view[y:y + self.block, x:x + self.block, :3] = (self.frames * 5) % 256
+        return SyntheticShot(data, (left, top), (width, height))
+
+    def close(self) -> None:
+        pass
+
+
+class SyntheticWindow:
+    """ Stands in for a pygetwindow window with a fixed box. """
+
+    def __init__(self, left: int, top: int, width: int, height: int, title: str = "Synthetic"):
+        self.left, self.top, self.width, self.height = left, top, width, height
+        self.title = title
+
+    @property
+    def box(self) -> Tuple[int, int, int, int]:
+        return self.left, self.top, self.width, self.height
+
+
+def make_source(source: str, window_title: str, size: Tuple[int, int]
+                ) -> Tuple[WindowCapture, Optional[Callable[[], object]]]:
+    """
+    Returns:
+        (WindowCapture, grabber factory or None for mss)
+    """
+    if source == 'window':
+        return WindowCapture(window_title), None
+
+    capture = WindowCapture(f"<{source}>", auto_init_dpi=False)
+    if source == 'screen':
+        # The whole primary display through real mss (e.g. an Xvfb display on Linux)
+        with mss.mss() as sct:
+            monitor = sct.monitors[1]
+        capture.window = SyntheticWindow(monitor['left'], monitor['top'], monitor['width'], monitor['height'])
+        return capture, None
+
+    width, height = size
+    capture.window = SyntheticWindow(32, 32, width, height)
+    return capture, lambda: SyntheticGrabber(width + 64, height + 64)
+
+
+# ==================== Modes ====================
+def _frame_loop(session: CaptureSession, mode: str, out_dir: str) -> Callable[[int], Dict[str, float]]:
+    """ One frame of `mode`, returning the seconds spent in each stage. """
+    out: List[Optional[np.ndarray]] = [None]
+
+    def raw(i: int) -> Dict[str, float]:
+        t0 = time.perf_counter()
+        session.grab()
+        return {'grab': time.perf_counter() - t0}
+
+    def array(i: int) -> Dict[str, float]:
+        t0 = time.perf_counter()
+        shot = session.grab()
+        t1 = time.perf_counter()
+        frame = np.frombuffer(shot.raw, dtype=np.uint8).reshape(shot.height, shot.width, 4)
+        if out[0] is None or out[0].shape != frame.shape:
+            out[0] = np.empty_like(frame)
+        np.copyto(out[0], frame)
+        return {'grab': t1 - t0, 'copy': time.perf_counter() - t1}
+
+    def png(i: int) -> Dict[str, float]:
+        # The stages of WindowCapture.capture()
+        t0 = time.perf_counter()
+        shot = session.grab()
+        t1 = time.perf_counter()
+        rgb = shot.rgb
+        t2 = time.perf_counter()
+        data = mss.tools.to_png(rgb, shot.size)
+        t3 = time.perf_counter()
+        with open(os.path.join(out_dir, f"frame_{i % 4}.png"), 'wb') as f:
+            f.write(data)
+        t4 = time.perf_counter()
+        return {'grab': t1 - t0, 'convert': t2 - t1, 'encode': t3 - t2, 'write': t4 - t3}
+
+    def regions(i: int) -> Dict[str, float]:
+        t0 = time.perf_counter()
+        session.grab_regions()
+        return {'grab': time.perf_counter() - t0}
+
+    converter = PixelConverter()
+
+    def convert(i: int) -> Dict[str, float]:
+        # What CaptureSession.grab_converted() does, split into stages
+        t0 = time.perf_counter()
+        shot = session.grab()
+        t1 = time.perf_counter()
+        converter.convert(as_bgra(shot.raw, shot.width, shot.height), mode)
+        return {'grab': t1 - t0, 'convert': time.perf_counter() - t1}
+
+    if mode in FORMATS:
+        return convert
+    return {'raw': raw, 'array': array, 'png': png, 'regions': regions}[mode]
+
+
+def _add_bench_regions(capture: WindowCapture) -> None:
+    """ A few HUD-sized regions spread over the window (logical pixels). """
+    _, _, width, height = capture.window.box
+    capture.add_region('bench_minimap', 8, 8, min(200, width // 4), min(150, height // 4))
+    capture.add_region('bench_hp', width // 3, height - 48, width // 3, 16)
+    capture.add_region('bench_center', width // 2 - 64, height // 2 - 64, 128, 128)
+
+
+def _memory_pass(step: Callable[[int], Dict[str, float]], frames: int) -> float:
+    """ Peak Python/numpy allocation (MiB) over `frames` frames; kept separate from timing. """
+    tracemalloc.start()
+    try:
+        for i in range(frames):
+            step(i)
+        _, peak = tracemalloc.get_traced_memory()
+    finally:
+        tracemalloc.stop()
+    return peak / 1024 / 1024
+
+
+def bench_session_mode(capture: WindowCapture, sct_factory, mode: str, frames: int, warmup: int,
+                       scale: Optional[float]) -> dict:
+    if mode == 'regions':
+        _add_bench_regions(capture)
+    out_dir = tempfile.mkdtemp(prefix="bench_capture_")
+    sct = sct_factory() if sct_factory else None
+    try:
+        with CaptureSession(capture, scale, sct) as session:
+            step = _frame_loop(session, mode, out_dir)
+            for i in range(warmup):
+                step(i)
+
+            stages: Dict[str, List[float]] = {}
+            start = time.perf_counter()
+            for i in range(frames):
+                for name, seconds in step(i).items():
+                    stages.setdefault(name, []).append(seconds * 1e3)
+            elapsed = time.perf_counter() - start
+
+            mem_peak = _memory_pass(step, min(frames, 30))
+            region = session.region
+    finally:
+        for name in os.listdir(out_dir):
+            os.remove(os.path.join(out_dir, name))
+        os.rmdir(out_dir)
+        if mode == 'regions':
+            for name in list(capture.regions):
+                if name.startswith('bench_'):
+                    capture.remove_region(name)
+
+    return {
+        'mode': mode,
+        'frames': frames,
+        'size': [region.width, region.height],
+        'fps': frames / elapsed if elapsed > 0 else 0.0,
+        'stages_ms': {name: percentiles(samples) for name, samples in stages.items()},
+        'mem_peak_mb': mem_peak,
+    }
+
+
+def bench_stream(capture: WindowCapture, sct_factory, frames: int, warmup: int,
+                 scale: Optional[float]) -> dict:
+    """ CaptureStream at full speed; stage 'wait' is the consumer's time in wait_next(). """
+    waits: List[float] = []
+    with CaptureStream(capture, fps=0, manual_scale=scale, sct_factory=sct_factory) as stream:
+        frame = stream.wait_next(timeout=5.0)
+        seq = frame.seq if frame else 0
+        consumed = 0
+        start = time.perf_counter()
+        while frame is not None and consumed < frames + warmup:
+            if consumed == warmup:
+                start = time.perf_counter()
+            t0 = time.perf_counter()
+            frame = stream.wait_next(seq, timeout=5.0)
+            if frame is None:
+                break
+            if consumed >= warmup:
+                waits.append((time.perf_counter() - t0) * 1e3)
+            seq = frame.seq
+            consumed += 1
+        elapsed = time.perf_counter() - start
+        stats = stream.stats()
+        size = [frame.image.shape[1], frame.image.shape[0]] if frame is not None else None
+
+    # Memory in a second short run (ring allocation included) so tracing does not skew the timing
+    tracemalloc.start()
+    try:
+        with CaptureStream(capture, fps=0, manual_scale=scale, sct_factory=sct_factory) as stream:
+            seq = 0
+            for _ in range(min(frames, 30)):
+                frame = stream.wait_next(seq, timeout=5.0)
+                if frame is None:
+                    break
+                seq = frame.seq
+        _, mem_peak = tracemalloc.get_traced_memory()
+    finally:
+        tracemalloc.stop()
+
+    return {
+        'mode': 'stream',
+        'frames': len(waits),
+        'size': size,
+        'fps': len(waits) / elapsed if elapsed > 0 else 0.0,
+        'stages_ms': {'wait': percentiles(waits), 'grab': {'mean': stats['avg_grab_ms']}},
+        'skipped': stats['skipped'],
+        'mem_peak_mb': mem_peak / 1024 / 1024,
+    }
+
+
+def _rss_peak_mb() -> Optional[float]:
+    try:
+        import resource
+    except ImportError:  # Windows
+        return None
+    peak = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    return peak / 1024 / 1024 if sys.platform == 'darwin' else peak / 1024
+
+
+def run(args) -> dict:
+    capture, sct_factory = make_source(args.source, args.window, args.size)
+    report = {
+        'meta': {
+            'source': args.source,
+            'window': args.window if args.source == 'window' else None,
+            'python': platform.python_version(),
+            'numpy': np.__version__,
+            'platform': platform.platform(),
+            'time': time.strftime('%Y-%m-%dT%H:%M:%S'),
+            'frames': args.frames,
+        },
+        'results': [],
+    }
+    for mode in args.modes:
+        logger.info(f"Capture bench: {mode}")
+        if mode == 'stream':
+            result = bench_stream(capture, sct_factory, args.frames, args.warmup, args.scale)
+        else:
+            result = bench_session_mode(capture, sct_factory, mode, args.frames, args.warmup, args.scale)
+        report['results'].append(result)
+    report['meta']['rss_peak_mb'] = _rss_peak_mb()
+    return report
+
+
+def print_report(report: dict):
+    meta = report['meta']
+    print(f"source={meta['source']} frames={meta['frames']} numpy={meta['numpy']} "
+          f"rss_peak={meta['rss_peak_mb'] or 0:.0f}MiB")
+    print(f"{'mode':<9}{'size':>11}{'fps':>9}{'stage':>10}{'p50ms':>9}{'p99ms':>9}{'maxms':>9}{'memMiB':>9}")
+    for r in report['results']:
+        size = f"{r['size'][0]}x{r['size'][1]}" if r['size'] else '-'
+        first = True
+        for stage, d in r['stages_ms'].items():
+            head = (f"{r['mode']:<9}{size:>11}{r['fps']:>9.1f}" if first else ' ' * 29)
+            tail = f"{r['mem_peak_mb']:>9.1f}" if first else ''
+            cells = ''.join(f"{d[k]:>9.2f}" if k in d else f"{'-':>9}" for k in ('p50', 'p99', 'max'))
+            if 'p50' not in d and 'mean' in d:  # stream grab time is only known as a mean
+                cells = f"{d['mean']:>9.2f}" + cells[9:]
+            print(f"{head}{stage:>10}{cells}{tail}")
+            first = False
+
+
+def _parse_size(text: str) -> Tuple[int, int]:
+    width, height = text.lower().split('x')
+    return int(width), int(height)
+
+
+def build_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(description="Capture path throughput / per-stage latency benchmark")
+    parser.add_argument('--source', choices=('synthetic', 'screen', 'window'), default='synthetic',
+                        help="synthetic: in-memory frames; screen: primary display via mss "
+                             "(works on an Xvfb display); window: a real window")
+    parser.add_argument('--window', default="MapleStory", help="window title for --source window")
+    parser.add_argument('--size', type=_parse_size, default=(1366, 768), help="synthetic window size, WxH")
+    parser.add_argument('--modes', nargs='+', choices=MODES, default=list(MODES))
+    parser.add_argument('--frames', type=int, default=300)
+    parser.add_argument('--warmup', type=int, default=10)
+    parser.add_argument('--scale', type=float, default=None, help="manual DPI scale (default: auto)")
+    parser.add_argument('--output', default=None, help="write JSON report to file")
+    parser.add_argument('--json', action='store_true', help="print JSON report")
+    return parser
+
+
+def main(argv=None) -> int:
+    args = build_parser().parse_args(argv)
+    try:
+        report = run(args)
+    except WindowCaptureException as e:
+        logger.error(f"Capture bench failed: {e}")
+        return 1
+
+    if args.output:
+        with open(args.output, 'w', encoding='utf-8') as f:
+            json.dump(report, f, indent=2)
+    if args.json:
+        print(json.dumps(report, indent=2))
+    else:
+        print_report(report)
+    return 0
+
+
+if __name__ == "__main__":
+    # Run:
+    #    python -m module.screenshot.bench_capture
+    #    python -m module.screenshot.bench_capture --modes raw png --frames 500 --output capture.json
+    #    xvfb-run -s "-screen 0 1920x1080x24" python -m module.screenshot.bench_capture --source screen
+    sys.exit(main())
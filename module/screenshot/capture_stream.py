@@ -0,0 +1,241 @@
+import sys
+import threading
+import time
+from dataclasses import dataclass
+from typing import Callable, Dict, List, Optional
+
+import numpy as np
+
+from module.logger import logger
+from module.screenshot.frame_diff import FrameChanges, FrameDiffer
+from module.screenshot.window_capture import CaptureSession, WindowCapture, WindowCaptureException
+
+
+@dataclass
+class Frame:
+    seq: int  # 1-based, increases by one per captured frame
+    timestamp: float  # time.perf_counter() right after the grab
+    slot: int
+    image: np.ndarray  # (h, w, 4) uint8 BGRA, a view on the ring slot (no copy)
+    changes: Optional[FrameChanges] = None  # set when the stream detects changes
+
+
+class CaptureStream:
+    """
+    Background capture thread writing into a ring of preallocated frame buffers.
+
+    The producer thread owns its own CaptureSession (mss handles are thread-bound)
+    and copies each grab into the next ring slot. Consumers get the newest frame
+    as a view on its slot, so they never wait for a capture and nothing is copied
+    on their side.
+
+    A slot is reused after `slots` more frames; a consumer that keeps a frame
+    longer than that should check `is_current(frame)` or copy the image.
+
+    Example:
+        with CaptureStream(WindowCapture("MapleStory"), fps=60) as stream:
+            frame = stream.wait_next()
+            while running:
+                process(frame.image)
+                frame = stream.wait_next(frame.seq)
+    """
+
+    def __init__(self, capture: WindowCapture, fps: float = 60.0, slots: int = 4,
+                 manual_scale: Optional[float] = None, detect_changes: bool = False,
+                 tile_size: int = 32, sct_factory: Optional[Callable[[], object]] = None):
+        """
+
+        Args:
+            capture: WindowCapture of the target window
+            fps: Target capture rate; 0 captures as fast as possible
+            slots: Number of preallocated frame buffers (>= 2)
+            manual_scale: Manually specify the scaling ratio; None for auto DPI
+            detect_changes: Diff every frame against the previous one (Frame.changes)
+                            and allow wait_next(changed_only=True)
+            tile_size: Tile edge in pixels for change detection
+            sct_factory: Creates the grabber on the producer thread (see CaptureSession sct);
+                         None uses mss
+        """
+        if slots < 2:
+            raise ValueError("slots must be >= 2")
+        self.capture = capture
+        self.fps = fps
+        self.slots = slots
+        self.manual_scale = manual_scale
+        self.sct_factory = sct_factory
+
+        self._ring: List[np.ndarray] = []
+        self._slot_seq: List[int] = [0] * slots
+        self._latest: Optional[Frame] = None
+        self._latest_changed: Optional[Frame] = None
+        self._differ = FrameDiffer(tile_size) if detect_changes else None
+        self._cond = threading.Condition()
+        self._stop = threading.Event()
+        self._thread: Optional[threading.Thread] = None
+        self.error: Optional[Exception] = None
+
+        # Statistics
+        self.produced = 0
+        self.missed_ticks = 0  # capture took longer than one frame period
+        self.skipped = 0  # frames overwritten before wait_next() saw them
+        self.unchanged = 0  # frames identical to the previous one
+        self.grab_time = 0.0
+        self._started_at = 0.0
+
+    # ==================== Producer ====================
+    def start(self) -> "CaptureStream":
+        if self._thread is not None and self._thread.is_alive():
+            return self
+        self._stop.clear()
+        self.error = None
+        self._thread = threading.Thread(target=self._run, name="CaptureStream", daemon=True)
+        self._started_at = time.perf_counter()
+        self._thread.start()
+        return self
+
+    def stop(self, timeout: float = 2.0) -> None:
+        self._stop.set()
+        if self._thread is not None:
+            self._thread.join(timeout)
+            self._thread = None
+        with self._cond:
+            self._cond.notify_all()
+
+    def _allocate(self, shape) -> None:
+        logger.info(f"CaptureStream: allocating {self.slots} slots of {shape[1]}x{shape[0]}")
+        self._ring = [np.empty(shape, dtype=np.uint8) for _ in range(self.slots)]
+        self._slot_seq = [0] * self.slots
+
+    def _run(self) -> None:
+        period = 1.0 / self.fps if self.fps > 0 else 0.0
+        try:
+            sct = self.sct_factory() if self.sct_factory else None
+            with CaptureSession(self.capture, self.manual_scale, sct) as session:
+                next_tick = time.perf_counter()
+                seq = 0
+                while not self._stop.is_set():
+                    t0 = time.perf_counter()
+                    shot = session.grab()
+                    src = np.frombuffer(shot.raw, dtype=np.uint8).reshape(shot.height, shot.width, 4)
+                    if not self._ring or self._ring[0].shape != src.shape:
+                        self._allocate(src.shape)  # first frame or window resized
+
+                    seq += 1
+                    slot = seq % self.slots
+                    self._slot_seq[slot] = 0  # mark as being written
+                    np.copyto(self._ring[slot], src)
+                    now = time.perf_counter()
+                    self._slot_seq[slot] = seq
+                    changes = self._differ.update(self._ring[slot]) if self._differ else None
+                    frame = Frame(seq=seq, timestamp=now, slot=slot, image=self._ring[slot], changes=changes)
+                    with self._cond:
+                        self._latest = frame
+                        if changes is not None:
+                            if changes.changed:
+                                self._latest_changed = frame
+                            else:
+                                self.unchanged += 1
+                        self.produced = seq
+                        self.grab_time += now - t0
+                        self._cond.notify_all()
+
+                    if period:
+                        next_tick += period
+                        delay = next_tick - time.perf_counter()
+                        if delay > 0:
+                            self._stop.wait(delay)
+                        else:
+                            # Behind schedule: drop the missed ticks instead of bursting
+                            missed = int(-delay // period) + 1
+                            self.missed_ticks += missed
+                            next_tick += (missed - 1) * period
+        except WindowCaptureException as e:
+            logger.error(f"CaptureStream stopped: {e}")
+            self.error = e
+        except Exception as e:
+            # Anything else (grabber factory, short grab, allocation) must still wake the consumers
+            logger.exception(f"CaptureStream crashed: {e!r}")
+            self.error = e
+        finally:
+            with self._cond:
+                self._cond.notify_all()
+
+    # ==================== Consumer ====================
+    def latest(self) -> Optional[Frame]:
+        """ Newest frame without waiting (None before the first capture). """
+        return self._latest
+
+    def wait_next(self, after_seq: int = 0, timeout: Optional[float] = 1.0,
+                  changed_only: bool = False) -> Optional[Frame]:
+        """
+        Wait for a frame newer than `after_seq`.
+
+        Args:
+            after_seq: seq of the last frame the caller processed (0 for any)
+            timeout: Seconds to wait; None waits forever
+            changed_only: Only return frames that differ from their predecessor
+                          (requires detect_changes=True); the caller sleeps while the screen is static
+
+        Returns:
+            Newest Frame, or None on timeout / producer stopped
+        """
+        if changed_only and self._differ is None:
+            raise ValueError("changed_only requires detect_changes=True")
+
+        def newest() -> Optional[Frame]:
+            return self._latest_changed if changed_only else self._latest
+
+        def stopped() -> bool:
+            thread = self._thread
+            return thread is None or not thread.is_alive() or self.error is not None
+
+        with self._cond:
+            ok = self._cond.wait_for(
+                lambda: (newest() is not None and newest().seq > after_seq) or stopped(),
+                timeout)
+            frame = newest()
+        if not ok or frame is None or frame.seq <= after_seq:
+            return None
+        if after_seq and not changed_only:
+            self.skipped += frame.seq - after_seq - 1
+        return frame
+
+    def is_current(self, frame: Frame) -> bool:
+        """ True while the frame's slot has not been overwritten by a newer capture. """
+        return self._slot_seq[frame.slot] == frame.seq
+
+    def stats(self) -> Dict[str, float]:
+        elapsed = time.perf_counter() - self._started_at if self._started_at else 0.0
+        return {
+            'produced': self.produced,
+            'fps': self.produced / elapsed if elapsed > 0 else 0.0,
+            'missed_ticks': self.missed_ticks,
+            'skipped': self.skipped,
+            'unchanged': self.unchanged,
+            'avg_grab_ms': self.grab_time / self.produced * 1e3 if self.produced else 0.0,
+        }
+
+    def __enter__(self):
+        return self.start()
+
+    def __exit__(self, exc_type, exc_val, exc_tb):
+        self.stop()
+
+
+def main():
+    logger.hr("Capture stream test", level=1)
+    capture = WindowCapture("MapleStory")
+    with CaptureStream(capture, fps=60) as stream:
+        frame = stream.wait_next()
+        deadline = time.perf_counter() + 3.0
+        while frame is not None and time.perf_counter() < deadline:
+            frame.image.mean()  # stand-in for vision work
+            frame = stream.wait_next(frame.seq)
+        logger.info(f"Stream stats: {stream.stats()}")
+    return 0
+
+
+if __name__ == "__main__":
+    # Run:
+    #    python -m module.screenshot.capture_stream
+    sys.exit(main())
@@ -0,0 +1,389 @@
+import argparse
+import os
+import queue
+import struct
+import sys
+import threading
+import time
+import zlib
+from bisect import bisect_right
+from typing import Iterator, List, NamedTuple, Optional, Tuple
+
+import numpy as np
+
+from module.logger import logger
+from module.screenshot.frame_diff import FrameDiffer
+
+# File layout (little-endian):
+#   Header:  magic 8s | version u16 | tile_size u16 | keyframe_interval u16 | reserved u16 | start_unix_ns u64
+#   Records: kind u8 | reserved u8 | width u16 | height u16 | timestamp f64 | payload_len u32 | payload
+#   Index:   written on close, one (offset u64, timestamp f64, kind u8) per frame
+#   Trailer: magic 8s | index_offset u64 | count u32
+# A file without trailer (recorder killed) is still readable; the index is rebuilt by a scan.
+REC_MAGIC = b'MSFRAMES'
+REC_VERSION = 1
+HEADER = struct.Struct('<8sHHHHQ')
+RECORD = struct.Struct('<BxHHdI')
+INDEX_ENTRY = struct.Struct('<QdB')
+TRAILER = struct.Struct('<8sQI')
+INDEX_MAGIC = b'MSFRIDX\0'
+
+KIND_KEY = 1  # zlib(BGRA pixels)
+KIND_DELTA = 2  # zlib(packed tile mask + XOR of each changed tile, raster order)
+KIND_SAME = 3  # identical to the previous frame, no payload
+KIND_NAMES = {KIND_KEY: 'key', KIND_DELTA: 'delta', KIND_SAME: 'same'}
+
+
+class IndexEntry(NamedTuple):
+    offset: int
+    timestamp: float
+    kind: int
+
+
+def _tile_slices(width: int, height: int, tile_size: int, mask: np.ndarray) -> Iterator[Tuple[slice, slice]]:
+    for row, col in np.argwhere(mask):
+        y, x = int(row) * tile_size, int(col) * tile_size
+        yield slice(y, min(y + tile_size, height)), slice(x, min(x + tile_size, width))
+
+
+class FrameRecorder:
+    """
+    Appends BGRA frames to one file: keyframes plus XOR tile deltas, zlib level 1.
+
+    The caller thread only diffs against the previous frame and copies the
+    changed tiles; compression and buffered sequential writes happen on a
+    writer thread. Every `keyframe_interval` frames (or on resize / when most
+    tiles changed) a keyframe starts a new segment, so seeking never decodes
+    more than one segment.
+
+    Example:
+        with FrameRecorder(logger.LOG_DIR_SCREENSHOT / "session.frames") as recorder:
+            frame = stream.wait_next()
+            while recording:
+                recorder.write(frame.image, frame.timestamp)
+                frame = stream.wait_next(frame.seq)
+    """
+
+    def __init__(self, path, tile_size: int = 32, keyframe_interval: int = 120,
+                 level: int = 1, queue_size: int = 32, key_ratio: float = 0.5):
+        """
+
+        Args:
+            path: Output file
+            tile_size: Delta tile edge in pixels
+            keyframe_interval: Frames per segment
+            level: zlib level (1 = fastest)
+            queue_size: Frames buffered for the writer thread before write() blocks
+            key_ratio: Write a keyframe instead of a delta when more tiles than this changed
+        """
+        self.path = str(path)
+        self.tile_size = tile_size
+        self.keyframe_interval = keyframe_interval
+        self.level = level
+        self.key_ratio = key_ratio
+        self._differ = FrameDiffer(tile_size, ignore_alpha=False)
+        self._since_key = 0
+        self._file = open(self.path, 'wb', buffering=1024 * 1024)
+        self._file.write(HEADER.pack(REC_MAGIC, REC_VERSION, tile_size, keyframe_interval, 0, time.time_ns()))
+        self._index: List[IndexEntry] = []
+        self._queue: queue.Queue = queue.Queue(queue_size)
+        self.error: Optional[Exception] = None
+
+        # Statistics
+        self.frames = 0
+        self.counts = {KIND_KEY: 0, KIND_DELTA: 0, KIND_SAME: 0}
+        self.bytes_in = 0
+        self.bytes_out = HEADER.size
+        self.encode_time = 0.0
+
+        self._thread = threading.Thread(target=self._run, name="FrameRecorder", daemon=True)
+        self._thread.start()
+
+    def write(self, image: np.ndarray, timestamp: Optional[float] = None) -> int:
+        """
+        Append one frame.
+
+        Args:
+            image: (h, w, 4) uint8 BGRA
+            timestamp: time.perf_counter() of the capture; now when None
+
+        Returns:
+            Record kind (KIND_KEY / KIND_DELTA / KIND_SAME)
+        """
+        if self.error is not None:
+            raise self.error
+        t0 = time.perf_counter()
+        height, width = image.shape[:2]
+        changes = self._differ.update(image)
+        diff = self._differ.last_diff
+
+        if diff is None or self._since_key >= self.keyframe_interval or changes.changed_ratio > self.key_ratio:
+            kind, payload = KIND_KEY, np.ascontiguousarray(image).tobytes()
+            self._since_key = 0
+        elif not changes.changed:
+            kind, payload = KIND_SAME, b''
+        else:
+            diff_bytes = diff.view(np.uint8).reshape(height, width, 4)
+            parts = [np.packbits(changes.mask).tobytes()]
+            parts.extend(diff_bytes[rows, cols].tobytes()
+                         for rows, cols in _tile_slices(width, height, self.tile_size, changes.mask))
+            kind, payload = KIND_DELTA, b''.join(parts)
+        self._since_key += 1
+
+        self.frames += 1
+        self.counts[kind] += 1
+        self.bytes_in += width * height * 4
+        self.encode_time += time.perf_counter() - t0
+        self._queue.put((kind, time.perf_counter() if timestamp is None else timestamp, width, height, payload))
+        return kind
+
+    def _run(self) -> None:
+        offset = HEADER.size
+        while True:
+            item = self._queue.get()
+            if item is None:
+                break
+            if self.error is not None:
+                continue  # drain so write() does not block forever
+            kind, timestamp, width, height, payload = item
+            try:
+                data = zlib.compress(payload, self.level) if payload else b''
+                self._file.write(RECORD.pack(kind, width, height, timestamp, len(data)))
+                self._file.write(data)
+            except (OSError, zlib.error) as e:
+                logger.error(f"FrameRecorder write failed: {e}")
+                self.error = e
+                continue
+            self._index.append(IndexEntry(offset, timestamp, kind))
+            offset += RECORD.size + len(data)
+            self.bytes_out = offset
+
+    def close(self) -> None:
+        """ Flush queued frames and write the index. """
+        if self._thread is None:
+            return
+        self._queue.put(None)
+        self._thread.join()
+        self._thread = None
+        if self.error is None:
+            index_offset = self.bytes_out
+            for entry in self._index:
+                self._file.write(INDEX_ENTRY.pack(*entry))
+            self._file.write(TRAILER.pack(INDEX_MAGIC, index_offset, len(self._index)))
+        self._file.close()
+
+    def stats(self) -> dict:
+        return {
+            'frames': self.frames,
+            'keyframes': self.counts[KIND_KEY],
+            'deltas': self.counts[KIND_DELTA],
+            'same': self.counts[KIND_SAME],
+            'ratio': self.bytes_in / self.bytes_out if self.bytes_out else 0.0,
+            'avg_encode_ms': self.encode_time / self.frames * 1e3 if self.frames else 0.0,
+        }
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb):
+        self.close()
+
+
+class FrameReader:
+    """
+    Random access over a FrameRecorder file.
+
+    read(n) decodes from the nearest keyframe at or before n, continuing from
+    the last decoded frame when reading forward.
+
+    Example:
+        with FrameReader("session.frames") as reader:
+            timestamp, image = reader.read(len(reader) // 2)
+    """
+
+    def __init__(self, path):
+        self.path = str(path)
+        self._file = open(self.path, 'rb')
+        header = self._file.read(HEADER.size)
+        if len(header) < HEADER.size:
+            raise ValueError(f"{path}: not a frame recording (too short)")
+        magic, version, self.tile_size, self.keyframe_interval, _, self.start_unix_ns = HEADER.unpack(header)
+        if magic != REC_MAGIC:
+            raise ValueError(f"{path}: not a frame recording (bad magic)")
+        if version != REC_VERSION:
+            raise ValueError(f"{path}: unsupported recording version {version}")
+        self.index = self._load_index()
+        self._keyframes = [i for i, entry in enumerate(self.index) if entry.kind == KIND_KEY]
+        self._current: Optional[np.ndarray] = None
+        self._position = -1
+
+    def _load_index(self) -> List[IndexEntry]:
+        size = os.fstat(self._file.fileno()).st_size
+        if size >= HEADER.size + TRAILER.size:
+            self._file.seek(size - TRAILER.size)
+            magic, index_offset, count = TRAILER.unpack(self._file.read(TRAILER.size))
+            if magic == INDEX_MAGIC and index_offset + count * INDEX_ENTRY.size + TRAILER.size == size:
+                self._file.seek(index_offset)
+                data = self._file.read(count * INDEX_ENTRY.size)
+                return [IndexEntry(*entry) for entry in INDEX_ENTRY.iter_unpack(data)]
+
+        # No trailer: the recorder did not close cleanly, scan the records
+        logger.warning(f"{self.path}: no index, scanning records")
+        index = []
+        offset = HEADER.size
+        while offset + RECORD.size <= size:
+            self._file.seek(offset)
+            kind, _, _, timestamp, length = RECORD.unpack(self._file.read(RECORD.size))
+            if kind not in KIND_NAMES or offset + RECORD.size + length > size:
+                break
+            index.append(IndexEntry(offset, timestamp, kind))
+            offset += RECORD.size + length
+        return index
+
+    def __len__(self) -> int:
+        return len(self.index)
+
+    def _decode(self, n: int) -> None:
+        """ Apply record n on top of the current frame. """
+        entry = self.index[n]
+        self._file.seek(entry.offset)
+        kind, width, height, _, length = RECORD.unpack(self._file.read(RECORD.size))
+        payload = zlib.decompress(self._file.read(length)) if length else b''
+
+        if kind == KIND_KEY:
+            self._current = np.frombuffer(payload, dtype=np.uint8).reshape(height, width, 4).copy()
+        elif kind == KIND_DELTA:
+            rows = -(-height // self.tile_size)
+            cols = -(-width // self.tile_size)
+            mask_len = (rows * cols + 7) // 8
+            mask = np.unpackbits(np.frombuffer(payload, dtype=np.uint8, count=mask_len),
+                                 count=rows * cols).reshape(rows, cols).astype(bool)
+            pos = mask_len
+            for row_slice, col_slice in _tile_slices(width, height, self.tile_size, mask):
+                tile = self._current[row_slice, col_slice]
+                n_bytes = tile.size
+                tile ^= np.frombuffer(payload, dtype=np.uint8, count=n_bytes, offset=pos).reshape(tile.shape)
+                pos += n_bytes
+        self._position = n
+
+    def read(self, n: int) -> Tuple[float, np.ndarray]:
+        """
+        Frame n (0-based).
+
+        Returns:
+            (timestamp, (h, w, 4) uint8 BGRA); the array is reused by the next read
+        """
+        if not 0 <= n < len(self.index):
+            raise IndexError(f"frame {n} out of range (0..{len(self.index) - 1})")
+        key = self._keyframes[bisect_right(self._keyframes, n) - 1]
+        start = self._position + 1 if key <= self._position <= n else key
+        for i in range(start, n + 1):
+            self._decode(i)
+        return self.index[n].timestamp, self._current
+
+    def __iter__(self) -> Iterator[Tuple[float, np.ndarray]]:
+        for n in range(len(self.index)):
+            yield self.read(n)
+
+    def info(self) -> dict:
+        size = os.path.getsize(self.path)
+        kinds = [entry.kind for entry in self.index]
+        duration = self.index[-1].timestamp - self.index[0].timestamp if len(self.index) > 1 else 0.0
+        return {
+            'frames': len(self.index),
+            'keyframes': kinds.count(KIND_KEY),
+            'deltas': kinds.count(KIND_DELTA),
+            'same': kinds.count(KIND_SAME),
+            'duration_s': duration,
+            'bytes': size,
+            'mb_per_s': size / duration / 1024 / 1024 if duration > 0 else None,
+        }
+
+    def close(self) -> None:
+        self._file.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb):
+        self.close()
+
+
+# ==================== CLI ====================
+def cmd_record(args) -> int:
+    from module.screenshot.capture_stream import CaptureStream
+    from module.screenshot.window_capture import WindowCapture
+
+    if args.synthetic:
+        from module.screenshot.bench_capture import make_source
+        capture, sct_factory = make_source('synthetic', args.window, (1366, 768))
+    else:
+        capture, sct_factory = WindowCapture(args.window), None
+    output = args.output or logger.LOG_DIR_SCREENSHOT / f"{time.strftime('%Y%m%d_%H%M%S')}.frames"
+
+    with FrameRecorder(output, keyframe_interval=args.keyframe_interval) as recorder, \
+            CaptureStream(capture, fps=args.fps, sct_factory=sct_factory) as stream:
+        logger.info(f"Recording to {output} for {args.duration}s")
+        deadline = time.perf_counter() + args.duration
+        frame = stream.wait_next()
+        try:
+            while frame is not None and time.perf_counter() < deadline:
+                recorder.write(frame.image, frame.timestamp)
+                frame = stream.wait_next(frame.seq)
+        except KeyboardInterrupt:
+            pass
+    logger.info(f"Recorder: {recorder.stats()}")
+    logger.info(f"Stream: {stream.stats()}")
+    return 0
+
+
+def cmd_info(args) -> int:
+    with FrameReader(args.file) as reader:
+        logger.info(f"{args.file}: {reader.info()}")
+    return 0
+
+
+def cmd_export(args) -> int:
+    import mss.tools
+
+    with FrameReader(args.file) as reader:
+        timestamp, image = reader.read(args.frame)
+        rgb = np.ascontiguousarray(image[..., 2::-1]).tobytes()
+        mss.tools.to_png(rgb, (image.shape[1], image.shape[0]), output=args.output)
+    logger.info(f"Frame {args.frame} (t={timestamp:.3f}) -> {args.output}")
+    return 0
+
+
+def main(argv=None) -> int:
+    parser = argparse.ArgumentParser(description="Delta-encoded frame recorder")
+    sub = parser.add_subparsers(dest='command', required=True)
+
+    p = sub.add_parser('record', help="record a window through CaptureStream")
+    p.add_argument('--window', default="MapleStory")
+    p.add_argument('--synthetic', action='store_true', help="record the synthetic bench source instead")
+    p.add_argument('--fps', type=float, default=60)
+    p.add_argument('--duration', type=float, default=10.0)
+    p.add_argument('--keyframe-interval', type=int, default=120)
+    p.add_argument('--output', default=None, help="default: log_screenshot/<time>.frames")
+    p.set_defaults(func=cmd_record)
+
+    p = sub.add_parser('info', help="summarize a recording")
+    p.add_argument('file')
+    p.set_defaults(func=cmd_info)
+
+    p = sub.add_parser('export', help="write one frame as PNG")
+    p.add_argument('file')
+    p.add_argument('frame', type=int)
+    p.add_argument('--output', default="frame.png")
+    p.set_defaults(func=cmd_export)
+
+    args = parser.parse_args(argv)
+    return args.func(args)
+
+
+if __name__ == "__main__":
+    # Run:
+    #    python -m module.screenshot.frame_recorder record --duration 30
+    #    python -m module.screenshot.frame_recorder info log_screenshot/20250101_120000.frames
+    #    python -m module.screenshot.frame_recorder export log_screenshot/20250101_120000.frames 300
+    sys.exit(main())
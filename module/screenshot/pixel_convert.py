@@ -0,0 +1,138 @@
+from typing import Dict, Optional, Tuple
+
+import numpy as np
+
+# Output formats: native BGRA, grayscale, and 2x / 4x box-downscaled variants
+FORMATS = ('bgra', 'gray', 'bgra/2', 'bgra/4', 'gray/2', 'gray/4')
+
+# BT.601 luma in 8.8 fixed point (B, G, R), weights sum to 256
+GRAY_WEIGHTS = (29, 150, 77)
+
+
+def parse_format(fmt: str) -> Tuple[str, int]:
+    """ 'gray/2' -> ('gray', 2) """
+    if fmt not in FORMATS:
+        raise ValueError(f"Unknown pixel format '{fmt}', choices: {', '.join(FORMATS)}")
+    base, _, factor = fmt.partition('/')
+    return base, int(factor) if factor else 1
+
+
+def output_shape(fmt: str, width: int, height: int) -> Tuple[int, ...]:
+    """ Shape of `fmt` for a width x height source; downscaling drops the partial edge blocks. """
+    base, factor = parse_format(fmt)
+    h, w = height // factor, width // factor
+    return (h, w, 4) if base == 'bgra' else (h, w)
+
+
+def as_bgra(raw, width: int, height: int) -> np.ndarray:
+    """ (h, w, 4) uint8 view on a raw BGRA grab buffer, no copy. """
+    return np.frombuffer(raw, dtype=np.uint8).reshape(height, width, 4)
+
+
+class PixelConverter:
+    """
+    Vectorized BGRA conversions into reusable destination arrays.
+
+    Every path is a handful of numpy ufunc passes with `out=` into scratch
+    buffers kept per shape, so steady-state conversion allocates nothing.
+    Integer arithmetic only: grayscale is 8.8 fixed point, box downscale
+    sums each factor x factor block in uint16 and rounds with a shift.
+
+    Example:
+        converter = PixelConverter()
+        gray = converter.convert(as_bgra(shot.raw, shot.width, shot.height), 'gray/2')
+    """
+
+    def __init__(self):
+        self._scratch: Dict[Tuple[str, Tuple[int, ...]], np.ndarray] = {}
+        self._outputs: Dict[Tuple[str, Tuple[int, ...]], np.ndarray] = {}
+
+    def _buffer(self, name: str, shape: Tuple[int, ...], dtype) -> np.ndarray:
+        key = (name, shape)
+        buf = self._scratch.get(key)
+        if buf is None:
+            buf = self._scratch[key] = np.empty(shape, dtype=dtype)
+        return buf
+
+    def _check_out(self, out: Optional[np.ndarray], fmt: str, shape: Tuple[int, ...]) -> np.ndarray:
+        if out is None:
+            key = (fmt, shape)
+            out = self._outputs.get(key)
+            if out is None:
+                out = self._outputs[key] = np.empty(shape, dtype=np.uint8)
+        elif out.shape != shape or out.dtype != np.uint8:
+            raise ValueError(f"out must be uint8 {shape} for '{fmt}', got {out.dtype} {out.shape}")
+        return out
+
+    def gray(self, src: np.ndarray, out: Optional[np.ndarray] = None) -> np.ndarray:
+        """
+        BGRA (h, w, 4) -> luma (h, w).
+
+        Args:
+            src: uint8 BGRA (any strides, e.g. a region slice)
+            out: Destination; None reuses a buffer owned by the converter
+        """
+        shape = src.shape[:2]
+        out = self._check_out(out, 'gray', shape)
+        acc = self._buffer('acc16', shape, np.uint16)
+        tmp = self._buffer('tmp16', shape, np.uint16)
+        wb, wg, wr = GRAY_WEIGHTS
+        np.multiply(src[..., 0], wb, out=acc, dtype=np.uint16)
+        np.multiply(src[..., 1], wg, out=tmp, dtype=np.uint16)
+        acc += tmp
+        np.multiply(src[..., 2], wr, out=tmp, dtype=np.uint16)
+        acc += tmp
+        acc += 128  # round to nearest
+        np.right_shift(acc, 8, out=out, casting='unsafe')
+        return out
+
+    def downscale(self, src: np.ndarray, factor: int, out: Optional[np.ndarray] = None) -> np.ndarray:
+        """
+        Box downscale by 2 or 4 (BGRA or gray), averaging each factor x factor block.
+
+        Args:
+            src: uint8 (h, w, 4) or (h, w)
+            factor: 2 or 4
+            out: Destination; None reuses a buffer owned by the converter
+        """
+        if factor not in (2, 4):
+            raise ValueError("factor must be 2 or 4")
+        h, w = src.shape[0] // factor, src.shape[1] // factor
+        channels = src.shape[2:]
+        shape = (h, w) + channels
+        out = self._check_out(out, f"{'bgra' if channels else 'gray'}/{factor}", shape)
+
+        # Sum rows, then columns, as strided adds; np.sum over a block reshape is ~10x slower
+        src = src[:h * factor, :w * factor]
+        rows = self._buffer(f'rows{factor}', (h, w * factor) + channels, np.uint16)
+        np.add(src[0::factor], src[1::factor], out=rows, dtype=np.uint16)
+        for k in range(2, factor):
+            np.add(rows, src[k::factor], out=rows)
+        acc = self._buffer(f'box{factor}', shape, np.uint16)
+        np.add(rows[:, 0::factor], rows[:, 1::factor], out=acc)
+        for k in range(2, factor):
+            np.add(acc, rows[:, k::factor], out=acc)
+        acc += factor * factor // 2  # round to nearest
+        np.right_shift(acc, 2 if factor == 2 else 4, out=out, casting='unsafe')
+        return out
+
+    def convert(self, src: np.ndarray, fmt: str, out: Optional[np.ndarray] = None) -> np.ndarray:
+        """
+        BGRA frame -> `fmt` (see FORMATS).
+
+        'bgra' returns `src` itself unless `out` is given. For 'gray/N' the
+        downscale runs first, so the luma pass only touches 1/N^2 of the pixels.
+        """
+        base, factor = parse_format(fmt)
+        if factor == 1:
+            if base == 'gray':
+                return self.gray(src, out)
+            if out is None:
+                return src
+            np.copyto(self._check_out(out, fmt, src.shape), src)
+            return out
+        if base == 'bgra':
+            return self.downscale(src, factor, out)
+        small = self.downscale(src, factor, self._buffer(f'bgra/{factor}', output_shape(
+            f'bgra/{factor}', src.shape[1], src.shape[0]), np.uint8))
+        return self.gray(small, out)
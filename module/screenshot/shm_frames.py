@@ -0,0 +1,296 @@
+"""
+Shared-memory frame ring for out-of-process consumers.
+
+A publisher (usually fed by CaptureStream) writes raw frames into a ring of
+slots in one shared-memory block; any number of reader processes attach by
+name and read the newest frame zero-copy. There are no locks: each slot is
+guarded by a pair of sequence numbers (seqlock), so readers detect frames
+that were overwritten while they were using them.
+
+Layout (little-endian):
+    Header (64 bytes):
+        magic 8s | version u16 | slots u16 | slot_bytes u32 | max_width u32 |
+        max_height u32 | channels u32 | latest_seq u64 | reserved
+    Slot i at 64 + i * (32 + slot_bytes):
+        seq_begin u64 | seq_end u64 | timestamp f64 | width u16 | height u16 |
+        stride u16 | format u16 | pixel data
+
+Writer: seq_begin = seq, copy pixels, write metadata, seq_end = seq, latest_seq = seq.
+Reader: slot is consistent while seq_begin == seq_end == seq.
+
+Uses multiprocessing.shared_memory: POSIX shm on Linux, a named file mapping
+on Windows.
+"""
+import struct
+import sys
+import time
+from dataclasses import dataclass
+from multiprocessing import shared_memory
+from typing import Optional
+
+import numpy as np
+
+from module.logger import logger
+
+MAGIC = b'HIDFRM1\0'
+VERSION = 1
+HEADER = struct.Struct('<8sHHIIIIQ')  # padded to HEADER_SIZE
+HEADER_SIZE = 64
+SLOT_HEADER = struct.Struct('<QQdHHHH')
+SLOT_HEADER_SIZE = 32
+LATEST_SEQ_OFFSET = 28
+
+FORMAT_BGRA = 1
+FORMAT_GRAY = 2
+FORMAT_NAMES = {FORMAT_BGRA: 'BGRA', FORMAT_GRAY: 'GRAY'}
+
+
+class SharedFrameError(Exception):
+    pass
+
+
+def _attach(name: str) -> shared_memory.SharedMemory:
+    """ Attach without letting this process's resource tracker unlink the block on exit. """
+    try:
+        return shared_memory.SharedMemory(name=name, track=False)  # Python 3.13+
+    except TypeError:
+        pass
+    if sys.platform == 'win32':
+        return shared_memory.SharedMemory(name=name)  # no resource tracker on Windows
+    # Older Pythons register every attach with the (possibly shared) resource tracker,
+    # which unlinks the block when the reader exits; skip the registration instead of
+    # unregistering afterwards, which would also drop the publisher's entry.
+    from multiprocessing import resource_tracker
+    register = resource_tracker.register
+    resource_tracker.register = lambda name, rtype: None
+    try:
+        return shared_memory.SharedMemory(name=name)
+    finally:
+        resource_tracker.register = register
+
+
+class SharedFramePublisher:
+    """
+    Writes frames into a shared-memory ring.
+
+    Example:
+        with SharedFramePublisher("maple_frames", 1920, 1080) as pub:
+            with CaptureStream(capture) as stream:
+                frame = stream.wait_next()
+                while frame:
+                    pub.publish(frame.image, frame.timestamp)
+                    frame = stream.wait_next(frame.seq)
+    """
+
+    def __init__(self, name: str, max_width: int, max_height: int, slots: int = 4, channels: int = 4):
+        """
+
+        Args:
+            name: Shared-memory name readers attach to
+            max_width, max_height: Largest frame that will be published
+            slots: Ring length; a reader has slots - 1 frame periods to use a frame zero-copy
+            channels: 4 for BGRA, 1 for grayscale
+        """
+        if channels not in (1, 4):
+            raise ValueError("channels must be 1 (gray) or 4 (BGRA)")
+        if slots < 2:
+            raise ValueError("slots must be >= 2")
+        self.name = name
+        self.max_width = max_width
+        self.max_height = max_height
+        self.slots = slots
+        self.channels = channels
+        self.slot_bytes = max_width * max_height * channels
+        size = HEADER_SIZE + slots * (SLOT_HEADER_SIZE + self.slot_bytes)
+
+        self._shm = shared_memory.SharedMemory(name=name, create=True, size=size)
+        self._buf = self._shm.buf
+        self._buf[:HEADER_SIZE] = bytes(HEADER_SIZE)
+        HEADER.pack_into(self._buf, 0, MAGIC, VERSION, slots, self.slot_bytes,
+                         max_width, max_height, channels, 0)
+        self.seq = 0
+        logger.info(f"Shared frame ring '{name}': {slots} x {max_width}x{max_height}x{channels} "
+                    f"({size / 1024 / 1024:.1f} MiB)")
+
+    def _slot_offset(self, slot: int) -> int:
+        return HEADER_SIZE + slot * (SLOT_HEADER_SIZE + self.slot_bytes)
+
+    def publish(self, image: np.ndarray, timestamp: Optional[float] = None) -> int:
+        """
+        Copy one frame into the next slot.
+
+        Args:
+            image: (h, w, 4) BGRA or (h, w) gray uint8, matching `channels`
+            timestamp: time.perf_counter() of the capture; now when None
+
+        Returns:
+            Sequence number of the published frame
+        """
+        height, width = image.shape[:2]
+        channels = image.shape[2] if image.ndim == 3 else 1
+        if channels != self.channels or image.dtype != np.uint8:
+            raise SharedFrameError(f"expected uint8 with {self.channels} channel(s), got {image.shape} {image.dtype}")
+        if width > self.max_width or height > self.max_height:
+            raise SharedFrameError(f"frame {width}x{height} exceeds ring size {self.max_width}x{self.max_height}")
+
+        self.seq += 1
+        seq = self.seq
+        slot = seq % self.slots
+        offset = self._slot_offset(slot)
+        stride = width * channels
+        data = offset + SLOT_HEADER_SIZE
+
+        struct.pack_into('<Q', self._buf, offset, seq)  # seq_begin: slot is being written
+        dst = np.ndarray((height, stride), dtype=np.uint8, buffer=self._buf, offset=data)
+        np.copyto(dst, image.reshape(height, stride))
+        fmt = FORMAT_BGRA if channels == 4 else FORMAT_GRAY
+        struct.pack_into('<dHHHH', self._buf, offset + 16,
+                         time.perf_counter() if timestamp is None else timestamp,
+                         width, height, stride, fmt)
+        struct.pack_into('<Q', self._buf, offset + 8, seq)  # seq_end: slot complete
+        struct.pack_into('<Q', self._buf, LATEST_SEQ_OFFSET, seq)
+        return seq
+
+    def close(self, unlink: bool = True) -> None:
+        if self._shm is None:
+            return
+        self._buf = None
+        self._shm.close()
+        if unlink:
+            self._shm.unlink()
+        self._shm = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb):
+        self.close()
+
+
+@dataclass
+class SharedFrame:
+    seq: int
+    timestamp: float
+    format: int
+    image: np.ndarray  # view into shared memory unless read with copy=True
+    _reader: "SharedFrameReader"
+    _slot_offset: int
+
+    def is_valid(self) -> bool:
+        """ False once the publisher has started overwriting this frame's slot. """
+        return self._reader._slot_seq_begin(self._slot_offset) == self.seq
+
+
+class SharedFrameReader:
+    """
+    Attaches to a SharedFramePublisher ring by name (from any process).
+
+    Example:
+        reader = SharedFrameReader("maple_frames")
+        last = 0
+        while True:
+            frame = reader.read_latest(after_seq=last)
+            if frame is None:
+                time.sleep(0.001)
+                continue
+            result = analyze(frame.image)
+            if frame.is_valid():  # not overwritten while we were reading it
+                last = frame.seq
+    """
+
+    def __init__(self, name: str):
+        self.name = name
+        self._shm = _attach(name)
+        self._buf = self._shm.buf
+        magic, version, self.slots, self.slot_bytes, self.max_width, self.max_height, \
+            self.channels, _ = HEADER.unpack_from(self._buf, 0)
+        if magic != MAGIC:
+            self.close()
+            raise SharedFrameError(f"'{name}' is not a shared frame ring")
+        if version != VERSION:
+            self.close()
+            raise SharedFrameError(f"'{name}': unsupported ring version {version}")
+        self.torn_reads = 0
+
+    @property
+    def latest_seq(self) -> int:
+        return struct.unpack_from('<Q', self._buf, LATEST_SEQ_OFFSET)[0]
+
+    def _slot_seq_begin(self, offset: int) -> int:
+        return struct.unpack_from('<Q', self._buf, offset)[0]
+
+    def read_latest(self, after_seq: int = 0, copy: bool = False, retries: int = 3) -> Optional[SharedFrame]:
+        """
+        Newest frame newer than `after_seq`.
+
+        Args:
+            after_seq: Return None unless a newer frame exists
+            copy: Copy the pixels out and verify the copy is consistent
+            retries: Attempts when the slot is being rewritten during the read
+
+        Returns:
+            SharedFrame or None
+        """
+        for _ in range(retries):
+            seq = self.latest_seq
+            if seq == 0 or seq <= after_seq:
+                return None
+            offset = HEADER_SIZE + (seq % self.slots) * (SLOT_HEADER_SIZE + self.slot_bytes)
+            begin, end, timestamp, width, height, stride, fmt = SLOT_HEADER.unpack_from(self._buf, offset)
+            if begin != seq or end != seq:
+                self.torn_reads += 1
+                continue
+
+            shape = (height, width, 4) if fmt == FORMAT_BGRA else (height, width)
+            image = np.ndarray((height, stride), dtype=np.uint8, buffer=self._buf,
+                               offset=offset + SLOT_HEADER_SIZE).reshape(shape)
+            if copy:
+                image = image.copy()
+                if self._slot_seq_begin(offset) != seq:
+                    self.torn_reads += 1
+                    continue
+            return SharedFrame(seq, timestamp, fmt, image, self, offset)
+        return None
+
+    def close(self) -> None:
+        if self._shm is None:
+            return
+        self._buf = None
+        try:
+            self._shm.close()
+        except BufferError:
+            pass  # frames handed out still reference the mapping
+        self._shm = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb):
+        self.close()
+
+
+def main():
+    """ Publish the MapleStory window into the ring 'maple_frames' until Ctrl+C. """
+    from module.screenshot.capture_stream import CaptureStream
+    from module.screenshot.window_capture import WindowCapture
+
+    capture = WindowCapture("MapleStory")
+    region = capture.get_geometry().region
+    with SharedFramePublisher("maple_frames", region.width, region.height) as publisher, \
+            CaptureStream(capture, fps=60) as stream:
+        logger.info("Publishing to 'maple_frames', Ctrl+C to stop")
+        try:
+            frame = stream.wait_next()
+            while frame is not None:
+                publisher.publish(frame.image, frame.timestamp)
+                frame = stream.wait_next(frame.seq)
+        except KeyboardInterrupt:
+            pass
+        logger.info(f"Published {publisher.seq} frames, stream stats: {stream.stats()}")
+    return 0
+
+
+if __name__ == "__main__":
+    # Run:
+    #    python -m module.screenshot.shm_frames
+    sys.exit(main())
@@ -1,15 +1,19 @@
 import ctypes
 import sys
+import time
 from module.logger import logger
 from typing import Dict, List, Optional, Tuple
 from dataclasses import dataclass
 from enum import Enum
 from pathlib import Path
 
+import numpy as np
 import pygetwindow as gw
 import mss
 import mss.tools
 
+from module.screenshot.pixel_convert import PixelConverter, as_bgra
+
 
 class WindowCaptureException(Exception):
     pass
@@ -98,6 +102,17 @@ class CaptureRegion:
         }
 
 
+@dataclass
+class WindowGeometry:
+    """ Resolved capture geometry of a window, valid while its box does not change. """
+    box: Tuple[int, int, int, int]  # (left, top, width, height), logical
+    manual_scale: Optional[float]
+    monitor: Optional[MonitorInfo]
+    scale: float
+    region: CaptureRegion  # physical pixels
+    version: int  # increases on every recalculation
+
+
 # ==================== Windows API ====================
 class RECT(ctypes.Structure):
     """Windows RECT Strct """
@@ -117,6 +132,14 @@ class RECT(ctypes.Structure):
         return self.bottom - self.top
 
 
+class POINT(ctypes.Structure):
+    """Windows POINT Strct """
+    _fields_ = [
+        ('x', ctypes.c_long),
+        ('y', ctypes.c_long)
+    ]
+
+
 class MONITORINFO(ctypes.Structure):
     """Windows MONITORINFO  Strct
     typedef struct tagMONITORINFO {
@@ -236,6 +259,7 @@ class MonitorManager:
 
     def __init__(self):
         self.monitors: List[MonitorInfo] = []
+        self._last_hit: Optional[MonitorInfo] = None
         self._detect_monitors()
 
     def _detect_monitors(self) -> None:
@@ -337,9 +361,15 @@ class MonitorManager:
         Returns:
             MonitorInfo / None
         """
+        # The window usually stays on the same screen, try the last hit first
+        last = self._last_hit
+        if last is not None and last.x <= x < last.x + last.width and last.y <= y < last.y + last.height:
+            return last
+
         for monitor in self.monitors:
             if (monitor.x <= x < monitor.x + monitor.width and
                 monitor.y <= y < monitor.y + monitor.height):
+                self._last_hit = monitor
                 return monitor
 
         logger.warning(f"Pos ({x}, {y}) not within the range of any known screen")
@@ -404,6 +434,13 @@ class WindowCapture:
         self.window_title = window_title
         self.window: Optional[gw.Win32Window] = None
         self.monitor_manager: Optional[MonitorManager] = None
+        # Named regions relative to the window (logical pixels), see add_region()
+        self.regions: Dict[str, CaptureRegion] = {}
+        self.regions_version = 0
+        # Geometry cache, see get_geometry()
+        self._geometry: Optional[WindowGeometry] = None
+        self._geometry_version = 0
+        self._last_position: Optional[Tuple[int, int, int, int]] = None
 
         if auto_init_dpi:
             self._initialize_dpi()
@@ -481,29 +518,98 @@ class WindowCapture:
         if self.window is None:
             raise WindowNotFoundError("Call find_window() first.")
 
-        if (abs(self.window.top) > self.COORDINATE_THRESHOLD or
-            abs(self.window.left) > self.COORDINATE_THRESHOLD):
+        return self._position_from_box(tuple(self.window.box))  # one GetWindowRect call
+
+    def _position_from_box(self, box: Tuple[int, int, int, int]) -> WindowPosition:
+        """Validate a window box already read from the window and wrap it in a WindowPosition"""
+        left, top, width, height = box
+
+        if (abs(top) > self.COORDINATE_THRESHOLD or
+            abs(left) > self.COORDINATE_THRESHOLD):
             error_msg = (
                 f"Window '{self.window.title}' abnormal, not in frontend\n"
-                f"  Pos: x={self.window.left}, y={self.window.top}\n"
+                f"  Pos: x={left}, y={top}\n"
                 f"  Please check if the window is minimized or obscured."
             )
             logger.error(error_msg)
             raise WindowNotForegroundError(error_msg)
 
         position = WindowPosition(
-            left=self.window.left,
-            top=self.window.top,
-            width=self.window.width,
-            height=self.window.height,
+            left=left,
+            top=top,
+            width=width,
+            height=height,
             title=self.window.title
         )
 
-        logger.info(f"Win pos: x={position.left}, y={position.top}, "
-                   f"w={position.width}, h={position.height}")
+        # Only log when the window moved or was resized
+        if (left, top, width, height) != self._last_position:
+            self._last_position = (left, top, width, height)
+            logger.info(f"Win pos: x={position.left}, y={position.top}, "
+                       f"w={position.width}, h={position.height}")
 
         return position
 
+    def get_geometry(self, manual_scale: Optional[float] = None) -> WindowGeometry:
+        """
+        Cached capture geometry of the window.
+
+        Costs one GetWindowRect call when nothing changed; the monitor lookup,
+        DPI scaling and region math (and their logging) only run again when the
+        window moves or is resized, the manual scale changes, or after
+        invalidate_geometry().
+
+        Args:
+            manual_scale: Manually specify the scaling ratio; None for auto DPI
+
+        Returns:
+            WindowGeometry
+        """
+        if self.window is None:
+            self.find_window()
+
+        box = tuple(self.window.box)
+        geometry = self._geometry
+        if geometry is not None and geometry.box == box and geometry.manual_scale == manual_scale:
+            return geometry
+
+        position = self._position_from_box(box)
+        monitor = None
+        if self.monitor_manager is not None:
+            monitor = self.monitor_manager.get_monitor_at_point(position.left + position.width // 2,
+                                                                position.top + position.height // 2)
+        if manual_scale is not None:
+            scale = manual_scale
+        else:
+            scale = monitor.scale_factor if monitor else 1.0
+
+        region = CaptureRegion(
+            left=int(position.left * scale),
+            top=int(position.top * scale),
+            width=int(position.width * scale),
+            height=int(position.height * scale)
+        )
+        logger.info(f"Capture geometry: {monitor.name if monitor else 'unknown screen'}, "
+                    f"scale {scale:.2f}x{' (manual)' if manual_scale is not None else ''}, "
+                    f"area (entity pixels) left={region.left}, top={region.top}, "
+                    f"width={region.width}, height={region.height}")
+
+        self._geometry_version += 1
+        self._geometry = WindowGeometry(box=box, manual_scale=manual_scale, monitor=monitor,
+                                        scale=scale, region=region, version=self._geometry_version)
+        return self._geometry
+
+    def invalidate_geometry(self, redetect_monitors: bool = False) -> None:
+        """
+        Drop the cached geometry (e.g. after a DPI or display layout change).
+
+        Args:
+            redetect_monitors: Also re-enumerate the monitors and their DPI
+        """
+        self._geometry = None
+        if redetect_monitors and self.monitor_manager is not None:
+            self.monitor_manager = MonitorManager()
+
     def calculate_capture_region(self,
                                  position: Optional[WindowPosition] = None,
                                  use_manual_scale: Optional[float] = None) -> CaptureRegion:
@@ -520,26 +626,7 @@ class WindowCapture:
         if position is None:
             position = self.get_window_position()
 
-        if use_manual_scale is not None:
-            scale = use_manual_scale
-            logger.info(f"Use manual scaling: {scale:.2f}x")
-        else:
-            if self.monitor_manager is None:
-                logger.warning("MonitorManager is not initialized; use the default scaling of 1.0x.")
-                scale = 1.0
-            else:
-                # Use the center point of the window to determine the current screen.
-                center_x = position.left + position.width // 2
-                center_y = position.top + position.height // 2
-
-                monitor = self.monitor_manager.get_monitor_at_point(center_x, center_y)
-
-                if monitor:
-                    scale = monitor.scale_factor
-                    logger.info(f"The viewport is located at {monitor.name}, DPI scaling is: {scale:.2f}x")
-                else:
-                    scale = 1.0
-                    logger.warning("Unable to determine the screen size of the window, using the default scaling 1.0x")
+        scale = self.resolve_scale(position, use_manual_scale)
 
         region = CaptureRegion(
             left=int(position.left * scale),
@@ -554,6 +641,116 @@ class WindowCapture:
 
         return region
 
+    def resolve_scale(self, position: WindowPosition, use_manual_scale: Optional[float] = None) -> float:
+        """
+        DPI scaling of the screen the window is on.
+
+        Args:
+            position: Window position (logical coordinates)
+            use_manual_scale: Manually specify the scaling ratio; if set to None, it will be automatically detected.
+
+        Returns:
+            Scale factor (1.0 = 100%)
+        """
+        if use_manual_scale is not None:
+            logger.info(f"Use manual scaling: {use_manual_scale:.2f}x")
+            return use_manual_scale
+
+        if self.monitor_manager is None:
+            logger.warning("MonitorManager is not initialized; use the default scaling of 1.0x.")
+            return 1.0
+
+        # Use the center point of the window to determine the current screen.
+        center_x = position.left + position.width // 2
+        center_y = position.top + position.height // 2
+
+        monitor = self.monitor_manager.get_monitor_at_point(center_x, center_y)
+
+        if monitor:
+            logger.info(f"The viewport is located at {monitor.name}, DPI scaling is: {monitor.scale_factor:.2f}x")
+            return monitor.scale_factor
+
+        logger.warning("Unable to determine the screen size of the window, using the default scaling 1.0x")
+        return 1.0
+
+    # ==================== Named regions (multi-ROI) ====================
+    def add_region(self, name: str, left: int, top: int, width: int, height: int) -> None:
+        """
+        Register a named region relative to the window's top-left corner.
+
+        Args:
+            name: Region name (e.g. "hp_bar", "minimap")
+            left, top, width, height: Logical pixels, the same units as get_window_position()
+        """
+        if width <= 0 or height <= 0:
+            raise ValueError(f"Region '{name}' needs a positive size, got {width}x{height}")
+        self.regions[name] = CaptureRegion(left=left, top=top, width=width, height=height)
+        self.regions_version += 1
+
+    def remove_region(self, name: str) -> None:
+        self.regions.pop(name, None)
+        self.regions_version += 1
+
+    def calculate_region_layout(self, window_region: CaptureRegion,
+                                scale: float) -> Tuple[CaptureRegion, Dict[str, Tuple[slice, slice]]]:
+        """
+        Union of all named regions in physical pixels, plus each region's slice inside it.
+
+        Args:
+            window_region: Physical capture region of the whole window
+            scale: DPI scaling applied to the logical region offsets
+
+        Returns:
+            (union CaptureRegion, {name: (row slice, col slice)})
+        """
+        if not self.regions:
+            raise WindowCaptureException("No regions registered, call add_region() first")
+
+        physical = {}
+        for name, rel in self.regions.items():
+            left = window_region.left + int(rel.left * scale)
+            top = window_region.top + int(rel.top * scale)
+            physical[name] = (left, top, left + int(rel.width * scale), top + int(rel.height * scale))
+
+        union_left = min(r[0] for r in physical.values())
+        union_top = min(r[1] for r in physical.values())
+        union_right = max(r[2] for r in physical.values())
+        union_bottom = max(r[3] for r in physical.values())
+        union = CaptureRegion(left=union_left, top=union_top,
+                              width=union_right - union_left, height=union_bottom - union_top)
+
+        slices = {
+            name: (slice(top - union_top, bottom - union_top), slice(left - union_left, right - union_left))
+            for name, (left, top, right, bottom) in physical.items()
+        }
+        return union, slices
+
+    def capture_regions(self, manual_scale: Optional[float] = None) -> Dict[str, np.ndarray]:
+        """
+        Grab every named region with a single grab of their bounding union.
+
+        For repeated use prefer CaptureSession.grab_regions(), which keeps the
+        grabber open and caches the layout.
+
+        Args:
+            manual_scale: Manually specify the scaling ratio
+
+        Returns:
+            {name: (h, w, 4) uint8 BGRA view into the union frame}
+        """
+        geometry = self.get_geometry(manual_scale)
+        union, slices = self.calculate_region_layout(geometry.region, geometry.scale)
+
+        try:
+            with mss.mss() as sct:
+                shot = sct.grab(union.to_mss_monitor())
+        except Exception as e:
+            logger.error(f"Screenshot failed: {e}")
+            raise WindowCaptureException(f"Screenshot failed: {e}")
+
+        frame = np.frombuffer(shot.raw, dtype=np.uint8).reshape(shot.height, shot.width, 4)
+        return {name: frame[rows, cols] for name, (rows, cols) in slices.items()}
+
     def capture(self,
                 output_path: str = "screenshot.png",
                 manual_scale: Optional[float] = None) -> str:
@@ -572,8 +769,8 @@ class WindowCapture:
         if self.window is None:
             self.find_window()
 
-        # Calculate the screenshot area
-        region = self.calculate_capture_region(use_manual_scale=manual_scale)
+        # Screenshot area, recalculated only when the window moved
+        region = self.get_geometry(manual_scale).region
 
         try:
             with mss.mss() as sct:
@@ -635,6 +832,182 @@ class WindowCapture:
         center_y = position.top + position.height // 2
         return self.monitor_manager.get_monitor_at_point(center_x, center_y)
 
+    @staticmethod
+    def get_cursor_position() -> Tuple[int, int]:
+        """
+        Cursor position in the same coordinates as get_window_position()
+        (GetCursorPos under this process's DPI awareness).
+        """
+        point = POINT()
+        if not ctypes.windll.user32.GetCursorPos(ctypes.byref(point)):
+            raise WindowCaptureException("GetCursorPos failed")
+        return point.x, point.y
+
+    def get_cursor_in_window(self) -> Tuple[int, int]:
+        """ Cursor position relative to the window's top-left corner (may be outside the window). """
+        x, y = self.get_cursor_position()
+        position = self.get_window_position()
+        return x - position.left, y - position.top
+
+    def get_cursor_monitor(self) -> Optional[MonitorInfo]:
+        if self.monitor_manager is None:
+            return None
+        return self.monitor_manager.get_monitor_at_point(*self.get_cursor_position())
+
+
+class CaptureSession:
+    """
+    Persistent capture of one window for high-rate loops.
+
+    Keeps a single mss handle open and uses WindowCapture.get_geometry(), so a
+    frame costs one geometry query and one grab: no PNG encode, no disk I/O,
+    no per-frame logging.
+
+    mss handles are bound to the thread that created them (GDI DCs on Windows),
+    so create and use a session from the same thread.
+
+    Example:
+        with CaptureSession(WindowCapture("MapleStory")) as session:
+            while True:
+                frame = session.grab_array()  # (h, w, 4) uint8, BGRA
+    """
+
+    def __init__(self, capture: WindowCapture, manual_scale: Optional[float] = None, sct=None):
+        """
+
+        Args:
+            capture: WindowCapture of the target window (find_window() is called if needed)
+            manual_scale: Manually specify the scaling ratio; None for auto DPI
+            sct: mss-compatible grabber to use instead of mss.mss() (e.g. a synthetic
+                 source for benchmarks); closed with the session
+        """
+        self.capture = capture
+        self.manual_scale = manual_scale
+        self._sct = sct if sct is not None else mss.mss()
+        self._geometry: Optional[WindowGeometry] = None
+        self._monitor: Optional[Dict[str, int]] = None
+        self._layout_key = None
+        self._layout: Optional[Tuple[Dict[str, int], Dict[str, Tuple[slice, slice]]]] = None
+        self._converter: Optional[PixelConverter] = None
+        self.frames = 0
+        self.region_updates = 0
+
+        if self.capture.window is None:
+            self.capture.find_window()
+
+    @property
+    def region(self) -> CaptureRegion:
+        """ Capture region in physical pixels, recalculated only when the window geometry changes. """
+        geometry = self.capture.get_geometry(self.manual_scale)
+        if geometry is not self._geometry:
+            self._geometry = geometry
+            self._monitor = geometry.region.to_mss_monitor()
+            self.region_updates += 1
+        return geometry.region
+
+    def invalidate(self) -> None:
+        """ Force the region to be recalculated on the next grab (e.g. after a DPI change). """
+        self.capture.invalidate_geometry()
+
+    def grab(self):
+        """
+        Grab one frame.
+
+        Returns:
+            mss ScreenShot; .raw is the BGRA bytearray (no conversion is done)
+        """
+        _ = self.region
+        try:
+            shot = self._sct.grab(self._monitor)
+        except Exception as e:
+            raise WindowCaptureException(f"Screenshot failed: {e}")
+        self.frames += 1
+        return shot
+
+    def grab_bgra(self) -> Tuple[bytearray, int, int]:
+        """
+        Returns:
+            (raw BGRA buffer, width, height); rows are width * 4 bytes
+        """
+        shot = self.grab()
+        return shot.raw, shot.width, shot.height
+
+    def grab_array(self, out: Optional["np.ndarray"] = None) -> "np.ndarray":
+        """
+        Grab one frame as a (height, width, 4) uint8 BGRA array.
+
+        Args:
+            out: Reusable destination array; when None the array is a view on the
+                 grab buffer (valid until the next grab, no copy)
+
+        Returns:
+            BGRA numpy array
+        """
+        shot = self.grab()
+        frame = np.frombuffer(shot.raw, dtype=np.uint8).reshape(shot.height, shot.width, 4)
+        if out is None:
+            return frame
+        if out.shape != frame.shape:
+            raise ValueError(f"out shape {out.shape} != frame shape {frame.shape}")
+        np.copyto(out, frame)
+        return out
+
+    def grab_converted(self, fmt: str = 'bgra', out: Optional["np.ndarray"] = None) -> "np.ndarray":
+        """
+        Grab one frame converted straight from the raw BGRA buffer.
+
+        Args:
+            fmt: 'bgra' (no conversion), 'gray', 'bgra/2', 'bgra/4', 'gray/2' or 'gray/4'
+                 (see module.screenshot.pixel_convert)
+            out: Reusable destination array; None reuses a session-owned buffer
+                 (for 'bgra', a view on the grab buffer), valid until the next grab
+
+        Returns:
+            uint8 array, (h, w, 4) for BGRA formats, (h, w) for gray
+        """
+        if self._converter is None:
+            self._converter = PixelConverter()
+        shot = self.grab()
+        return self._converter.convert(as_bgra(shot.raw, shot.width, shot.height), fmt, out)
+
+    def grab_regions(self) -> Dict[str, np.ndarray]:
+        """
+        Grab all regions registered with WindowCapture.add_region() in one grab.
+
+        The union rect and per-region slices are cached until the window moves
+        or the region set changes, so per-tick cost is one grab of the union area.
+
+        Returns:
+            {name: (h, w, 4) uint8 BGRA view into the union frame (valid until the next grab)}
+        """
+        region = self.region
+        key = (self._geometry.version, self.capture.regions_version)
+        if key != self._layout_key:
+            union, slices = self.capture.calculate_region_layout(region, self._geometry.scale)
+            self._layout = (union.to_mss_monitor(), slices)
+            self._layout_key = key
+
+        monitor, slices = self._layout
+        try:
+            shot = self._sct.grab(monitor)
+        except Exception as e:
+            raise WindowCaptureException(f"Screenshot failed: {e}")
+        self.frames += 1
+        frame = np.frombuffer(shot.raw, dtype=np.uint8).reshape(shot.height, shot.width, 4)
+        return {name: frame[rows, cols] for name, (rows, cols) in slices.items()}
+
+    def close(self) -> None:
+        if self._sct is not None:
+            self._sct.close()
+            self._sct = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb):
+        self.close()
+
+
 def quick_capture(window_title: str = "MapleStory",
                  output_path: str = "screenshot.png",
                  manual_scale: Optional[float] = None) -> str:
@@ -731,6 +1104,23 @@ def test_full_monitor_capture():
         raise
 
 
+def test_capture_session(window_title: str = "MapleStory", frames: int = 300):
+    logger.hr(f"Test 4: capture session FPS - '{window_title}'", level=1)
+
+    capture = WindowCapture(window_title)
+    with CaptureSession(capture) as session:
+        out = None
+        start = time.perf_counter()
+        for _ in range(frames):
+            frame = session.grab_array(out)
+            if out is None:
+                out = frame.copy()
+        elapsed = time.perf_counter() - start
+
+    logger.info(f"{frames} frames {out.shape[1]}x{out.shape[0]} in {elapsed:.3f}s "
+                f"= {frames / elapsed:.1f} FPS (region updates: {session.region_updates})")
+
+
 def main():
     global logger_debug
     logger_debug = True